@@ -2,18 +2,28 @@
 
 #ifdef __AVR_ARCH__
 #include <avr/interrupt.h>
+#include <util/atomic.h>
+#define DCCDECODE_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#else
+#define DCCDECODE_ATOMIC
 #endif
 
 namespace dccdecode {
 
-// Times for DCC, assuming a 1 MHz timer (which we approximately get with f_cpu = 8Mhz and a prescaler of 8)
-const uint8_t DCC_TIME_ONE = 58;
-const uint8_t DCC_TIME_ZERO = 100;
-const uint8_t DCC_WAIT_TIME = (uint16_t(DCC_TIME_ONE) + uint16_t(DCC_TIME_ZERO)) / 2;
+// Messages received, as a ring buffer with a single writer (the ISR) and a single reader (the
+// main loop). The ISR assembles the next message in messageQueue[queueWriteIndex] and only
+// publishes it by advancing queueWriteIndex once it is complete and the XOR matches. If that
+// would make the queue overflow, the message is dropped instead and its slot gets reused.
+volatile Message messageQueue[QUEUE_LENGTH];
+volatile uint8_t queueWriteIndex = 0;
+volatile uint8_t queueReadIndex = 0;
 
-volatile Message message;
-volatile uint8_t currentMessageNumber = 0;
-uint8_t lastReadMessageNumber = 0;
+volatile Statistics statistics;
+
+// Packet filter settings; the address window is precomputed by setPacketFilter().
+bool packetFilterEnabled = false;
+uint16_t packetFilterFirstAddress = 0;
+uint16_t packetFilterAddressCount = 0;
 
 #ifdef __AVR_ARCH__
 const uint8_t DCC_PIN_MASK = (1 << PB2);
@@ -26,10 +36,36 @@ void setupInt0PB2() {
   DDRB &= ~DCC_PIN_MASK;
 
   // DCC Input interrupt
+#ifdef DCCDECODE_EDGE_TIMING
+  MCUCR |= (1 << ISC00); // INT0 fires on any edge
+#else
   MCUCR |= (1 << ISC01); // INT0 fires on falling edge
+#endif
   GIMSK |= (1 << INT0);// Int0 is enabled
 }
 
+#ifdef DCCDECODE_EDGE_TIMING
+void setupTimer0() {
+  TCCR0A = 0; // Normal mode
+  TCCR0B = (1 << CS01); // Runs all the time, Clock/8; only read in ISR(INT0_vect)
+  TIMSK |= (1 << TOIE0); // Overflow interrupt for stretched zeros
+}
+
+// Edge on DCC in received.
+ISR(INT0_vect) {
+  const uint8_t ticks = TCNT0;
+  // The timer may have wrapped around after this interrupt started, but before the read
+  if ((TIFR & (1 << TOV0)) && ticks < 0x80) {
+    TIFR = (1 << TOV0); // Counted here instead of in ISR(TIMER0_OVF_vect)
+    timerOverflowed();
+  }
+  receivedEdge(ticks);
+}
+
+ISR(TIMER0_OVF_vect) {
+  timerOverflowed();
+}
+#else
 void setupTimer0() {
   OCR0A = DCC_WAIT_TIME;
   TCCR0A = 0;// Normal mode
@@ -51,7 +87,11 @@ ISR(TIMER0_COMPA_vect) {
   // Read bit value: If it's still low, then it was a long 0 wave; if it has changed to 1, it was a short 1 wave
   bool bitValue = (PINB & DCC_PIN_MASK);
   receivedBit(bitValue);
+#ifdef DCCDECODE_SAMPLE_HOOK
+  afterSample(bitValue, endedPacket(bitValue));
+#endif
 }
+#endif /* DCCDECODE_EDGE_TIMING */
 #endif /* __AVR_ARCH__ */
 
 enum DccReceiveState: uint8_t {
@@ -83,9 +123,70 @@ enum DccReceiveState: uint8_t {
   DCC_RECEIVE_STATE_AWAIT_SEPARATOR
 };
 
-void receivedBit(bool bitValue) {
-  static DccReceiveState receiveState;
-  static uint8_t runningXor = 0;
+#define DCCDECODE_ALWAYS_INLINE inline __attribute__((always_inline))
+
+static DCCDECODE_ALWAYS_INLINE void countEvent(volatile uint16_t &counter) {
+  if (counter != 0xFFFF) {
+    counter += 1;
+  }
+}
+
+// Whether a valid packet may be of interest to the main loop, see setPacketFilter().
+static bool passesPacketFilter(const volatile Message &message) {
+  if (!packetFilterEnabled) {
+    return true;
+  }
+
+  uint8_t firstByte = message.data[0];
+  if (firstByte == 0xFF) {
+    // Idle
+    return false;
+  }
+  if (message.isAccessoryMessage()) {
+    if (!message.isBasicAccessoryMessage() && !message.isExtendedAccessoryMessage()) {
+      return true;
+    }
+    if (message.isAccessoryBroadcast()) {
+      return true;
+    }
+    if (message.isAccessoryPom()) {
+      // POM; which address counts depends on the workarounds, so let the main loop decide
+      return true;
+    }
+    uint16_t outputAddress = message.getAccessoryOutputAddress();
+    return outputAddress == 2047 || uint16_t(outputAddress - packetFilterFirstAddress) < packetFilterAddressCount;
+  }
+
+  // Locomotive packets are never for us, except for broadcasts (which includes the reset)
+  // and service mode packets, which use the addresses 112-127.
+  return firstByte == 0 || (firstByte & 0xF0) == 0x70;
+}
+
+// Called at the end of a packet with a matching XOR; makes the message visible to popMessage().
+static DCCDECODE_ALWAYS_INLINE void publishMessage() {
+  const volatile Message &message = messageQueue[queueWriteIndex];
+  if (!passesPacketFilter(message)) {
+    countEvent(statistics.filteredPackets);
+    return;
+  }
+
+  uint8_t nextWriteIndex = (queueWriteIndex + 1) & (QUEUE_LENGTH - 1);
+  if (nextWriteIndex != queueReadIndex) {
+    queueWriteIndex = nextWriteIndex;
+    countEvent(statistics.deliveredPackets);
+  } else {
+    countEvent(statistics.queueOverruns);
+  }
+}
+
+// Decoder core with one state per bit position.
+static DccReceiveState switchDecoderState;
+static uint8_t switchDecoderXor = 0;
+
+static DCCDECODE_ALWAYS_INLINE void switchDecoderBit(bool bitValue) {
+  DccReceiveState &receiveState = switchDecoderState;
+  uint8_t &runningXor = switchDecoderXor;
+  volatile Message &message = messageQueue[queueWriteIndex];
 
   switch (receiveState) {
     case DCC_RECEIVE_STATE_PREAMBLE0:
@@ -101,6 +202,9 @@ void receivedBit(bool bitValue) {
       if (bitValue) {
         receiveState = DccReceiveState(receiveState + 1);
       } else {
+        if (receiveState != DCC_RECEIVE_STATE_PREAMBLE0) {
+          countEvent(statistics.preambleRestarts);
+        }
         receiveState = DCC_RECEIVE_STATE_PREAMBLE0;
       }
       break;
@@ -131,12 +235,15 @@ void receivedBit(bool bitValue) {
         // End of packet
         receiveState = DCC_RECEIVE_STATE_PREAMBLE0;
         if (runningXor == 0) {
-          currentMessageNumber += 1;
+          publishMessage();
+        } else {
+          countEvent(statistics.xorErrors);
         }
       } else {
         // Another byte follows
         if (message.length >= sizeof(message.data)) {
           // We can't store (nor process) the byte; ignore this message and wait for next preamble
+          countEvent(statistics.lengthOverflows);
           receiveState = DCC_RECEIVE_STATE_PREAMBLE0;
         } else {
           message.data[message.length] = 0;
@@ -147,13 +254,247 @@ void receivedBit(bool bitValue) {
   }
 }
 
+// Decoder core that shifts every bit into a register and only does real work at the end of
+// the preamble and at byte boundaries. Which pattern ends the current state is looked up in
+// a table:
+// - Preamble: The last eleven bits are ten 1s followed by the 0 start bit. Any 0 before
+//   that automatically resets the count since it gets shifted in as well.
+// - Byte: The register starts out as 1. Once that sentinel bit has been shifted up to
+//   bit 9, the eight data bits are in bits 1-8 and the separator in bit 0.
+enum TableDecoderState: uint8_t {
+  TABLE_DECODER_STATE_PREAMBLE = 0,
+  TABLE_DECODER_STATE_BYTE
+};
+
+struct TableDecoderTransition {
+  uint16_t mask;
+  uint16_t pattern;
+};
+
+static const TableDecoderTransition tableDecoderTransitions[] = {
+  /* TABLE_DECODER_STATE_PREAMBLE */ { 0x7FF, 0x7FE },
+  /* TABLE_DECODER_STATE_BYTE */ { 0x200, 0x200 },
+};
+
+static TableDecoderState tableDecoderState;
+static uint16_t tableDecoderShiftRegister = 0;
+static uint8_t tableDecoderXor = 0;
+
+static DCCDECODE_ALWAYS_INLINE void tableDecoderBit(bool bitValue) {
+  TableDecoderState &receiveState = tableDecoderState;
+  uint16_t &shiftRegister = tableDecoderShiftRegister;
+  uint8_t &runningXor = tableDecoderXor;
+
+  shiftRegister = (shiftRegister << 1) | bitValue;
+  const TableDecoderTransition &transition = tableDecoderTransitions[receiveState];
+  if ((shiftRegister & transition.mask) != transition.pattern) {
+    if (receiveState == TABLE_DECODER_STATE_PREAMBLE && (shiftRegister & 0x3) == 0x2) {
+      // A 0 after fewer than ten 1s
+      countEvent(statistics.preambleRestarts);
+    }
+    return;
+  }
+
+  volatile Message &message = messageQueue[queueWriteIndex];
+  if (receiveState == TABLE_DECODER_STATE_PREAMBLE) {
+    receiveState = TABLE_DECODER_STATE_BYTE;
+    shiftRegister = 1;
+    message.length = 0;
+    runningXor = 0;
+    return;
+  }
+
+  uint8_t receivedByte = uint8_t(shiftRegister >> 1);
+  message.data[message.length] = receivedByte;
+  message.length += 1;
+  runningXor ^= receivedByte;
+  if (shiftRegister & 1) {
+    // End of packet
+    receiveState = TABLE_DECODER_STATE_PREAMBLE;
+    shiftRegister = 0;
+    if (runningXor == 0) {
+      publishMessage();
+    } else {
+      countEvent(statistics.xorErrors);
+    }
+  } else if (message.length >= sizeof(message.data)) {
+    // We can't store (nor process) the next byte; ignore this message and wait for next preamble
+    countEvent(statistics.lengthOverflows);
+    receiveState = TABLE_DECODER_STATE_PREAMBLE;
+    shiftRegister = 0;
+  } else {
+    // Another byte follows
+    shiftRegister = 1;
+  }
+}
+
+void receivedBitSwitchDecoder(bool bitValue) {
+  switchDecoderBit(bitValue);
+}
+
+void receivedBitTableDecoder(bool bitValue) {
+  tableDecoderBit(bitValue);
+}
+
+void receivedBit(bool bitValue) {
+#ifdef DCCDECODE_TABLE_DECODER
+  tableDecoderBit(bitValue);
+#else
+  switchDecoderBit(bitValue);
+#endif
+}
+
+bool endedPacket(bool bitValue) {
+  // Only the end of a packet gets from a 1 back to waiting for the preamble; a length
+  // overflow or preamble restart does so with a 0.
+#ifdef DCCDECODE_TABLE_DECODER
+  return bitValue && tableDecoderState == TABLE_DECODER_STATE_PREAMBLE && tableDecoderShiftRegister == 0;
+#else
+  return bitValue && switchDecoderState == DCC_RECEIVE_STATE_PREAMBLE0;
+#endif
+}
+
+// Drops the packet receivedBit() is currently working on and waits for the next preamble.
+static void abortPacket() {
+#ifdef DCCDECODE_TABLE_DECODER
+  tableDecoderState = TABLE_DECODER_STATE_PREAMBLE;
+  tableDecoderShiftRegister = 0;
+#else
+  switchDecoderState = DCC_RECEIVE_STATE_PREAMBLE0;
+#endif
+}
+
+enum HalfBit: uint8_t {
+  HALF_BIT_NONE = 0,
+  HALF_BIT_ONE,
+  HALF_BIT_ZERO
+};
+
+// Timer overflows since the last edge; only 0, 1 and more matter
+static volatile uint8_t overflowsSinceEdge = 0;
+
+void timerOverflowed() {
+  if (overflowsSinceEdge < 2) {
+    overflowsSinceEdge++;
+  }
+}
+
+void receivedEdge(uint8_t ticks) {
+  static uint8_t lastEdgeTicks = 0;
+  static HalfBit firstHalf = HALF_BIT_NONE;
+
+  // Wraps around correctly as long as the half-bit is shorter than 256 ticks. It is at least
+  // that long if the timer wrapped around twice, or once and got past the last edge again.
+  const uint8_t overflows = overflowsSinceEdge;
+  overflowsSinceEdge = 0;
+  const bool longHalfBit = overflows > 1 || (overflows == 1 && ticks >= lastEdgeTicks);
+  uint8_t halfBitLength = ticks - lastEdgeTicks;
+  lastEdgeTicks = ticks;
+
+  HalfBit halfBit;
+  if (longHalfBit || halfBitLength >= DCC_HALF_BIT_ZERO_MIN) {
+    halfBit = HALF_BIT_ZERO;
+  } else if (halfBitLength >= DCC_HALF_BIT_ONE_MIN && halfBitLength <= DCC_HALF_BIT_ONE_MAX) {
+    halfBit = HALF_BIT_ONE;
+  } else {
+    // Out of spec, most likely noise. Whatever packet this was part of is lost.
+    firstHalf = HALF_BIT_NONE;
+    abortPacket();
+    return;
+  }
+
+  if (firstHalf == HALF_BIT_NONE) {
+    firstHalf = halfBit;
+  } else if (firstHalf == halfBit) {
+    receivedBit(halfBit == HALF_BIT_ONE);
+    firstHalf = HALF_BIT_NONE;
+  } else {
+    // The halves don't match, so we're off by one half-bit. In the preamble there is no way
+    // to tell, so this normally happens at the first 0 after it. Treat this as the first half.
+    firstHalf = halfBit;
+  }
+}
+
 bool hasNewMessage() {
-  uint8_t newMessageNumber = currentMessageNumber;
-  bool changed = (lastReadMessageNumber != newMessageNumber);
-  if (changed) {
-    lastReadMessageNumber = newMessageNumber;
+  return queueReadIndex != queueWriteIndex;
+}
+
+#ifndef __AVR_ARCH__
+void (*popMessageCopyHook)() = nullptr;
+#define DCCDECODE_COPY_HOOK() if (popMessageCopyHook) popMessageCopyHook()
+#else
+#define DCCDECODE_COPY_HOOK()
+#endif
+
+bool popMessage(Message &out) {
+  uint8_t readIndex = queueReadIndex;
+  if (readIndex == queueWriteIndex) {
+    return false;
+  }
+
+  const volatile Message &queued = messageQueue[readIndex];
+  out.length = queued.length;
+  DCCDECODE_COPY_HOOK();
+  for (uint8_t i = 0; i < out.length; i++) {
+    out.data[i] = queued.data[i];
+    DCCDECODE_COPY_HOOK();
+  }
+
+  // Only now may the ISR reuse the slot
+  queueReadIndex = (readIndex + 1) & (QUEUE_LENGTH - 1);
+  return true;
+}
+
+uint8_t getOverrunCount() {
+  uint16_t overruns;
+  DCCDECODE_ATOMIC {
+    overruns = statistics.queueOverruns;
+  }
+  return overruns > 0xFF ? 0xFF : uint8_t(overruns);
+}
+
+void setPacketFilter(uint16_t firstOutputAddress, uint16_t outputAddressCount) {
+  DCCDECODE_ATOMIC {
+    packetFilterFirstAddress = firstOutputAddress;
+    packetFilterAddressCount = outputAddressCount;
+    packetFilterEnabled = true;
+  }
+}
+
+void disablePacketFilter() {
+  packetFilterEnabled = false;
+}
+
+Statistics getStatistics() {
+  Statistics copy;
+  DCCDECODE_ATOMIC {
+    copy.deliveredPackets = statistics.deliveredPackets;
+    copy.filteredPackets = statistics.filteredPackets;
+    copy.addressedPackets = statistics.addressedPackets;
+    copy.preambleRestarts = statistics.preambleRestarts;
+    copy.xorErrors = statistics.xorErrors;
+    copy.lengthOverflows = statistics.lengthOverflows;
+    copy.queueOverruns = statistics.queueOverruns;
+  }
+  return copy;
+}
+
+void resetStatistics() {
+  DCCDECODE_ATOMIC {
+    statistics.deliveredPackets = 0;
+    statistics.filteredPackets = 0;
+    statistics.addressedPackets = 0;
+    statistics.preambleRestarts = 0;
+    statistics.xorErrors = 0;
+    statistics.lengthOverflows = 0;
+    statistics.queueOverruns = 0;
+  }
+}
+
+void countAddressedPacket() {
+  DCCDECODE_ATOMIC {
+    countEvent(statistics.addressedPackets);
   }
-  return changed;
 }
 
 }
\ No newline at end of file
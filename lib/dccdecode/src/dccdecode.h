@@ -1,3 +1,5 @@
+#pragma once
+
 #include <stdint.h>
 
 namespace dccdecode {
@@ -6,12 +8,16 @@ namespace dccdecode {
  * On ATTiny85, this uses:
  * - Int0 and PB2 for input
  * - Timer0 for reading the time
+ * By default, Timer0 gets started on every falling edge and the input sampled once it fires.
+ * With DCCDECODE_EDGE_TIMING defined at build time, Timer0 runs freely instead and every edge
+ * is timestamped, which needs only one interrupt per half-bit and checks the timing.
  */
 
-// Stores the DCC message with length and data.
+// Stores the DCC message with length and data. The longest packets are XPOM writes of four
+// CVs: two address bytes, 1110-GGSS, three CV bytes, four values and the XOR byte.
 struct Message {
   uint8_t length = 0;
-  uint8_t data[10];
+  uint8_t data[11];
 
   bool isGeneralReset() const volatile {
     return length == 3 && data[0] == 0 && data[1] == 0;
@@ -29,6 +35,20 @@ struct Message {
   bool isBasicAccessoryMessage() const volatile {
     return isAccessoryMessage() && (data[1] & 0x80) == 0x80;
   }
+  // Extended accessory (signal aspect): 10AA-AAAA 0AAA-0AA1 DDDD-DDDD, see RCN213.
+  // The address bits are the same as for basic accessories.
+  bool isExtendedAccessoryMessage() const volatile {
+    return length == 4 && isAccessoryMessage() && (data[1] & 0x89) == 0x01;
+  }
+  // Programming on the main for an accessory decoder (RCN-214): 1110-CCVV VVVV-VVVV DDDD-DDDD
+  // for one CV, or XPOM with 1110-GGSS, a 24 bit CV index and one to four values.
+  bool isAccessoryPom() const volatile {
+    return isAccessoryMessage() && (data[2] & 0xF0) == 0xE0 && (length == 6 || length >= 8);
+  }
+  // Decoder address 511, for all basic or extended accessory decoders
+  bool isAccessoryBroadcast() const volatile {
+    return isAccessoryMessage() && data[0] == 0xBF && (data[1] & 0x70) == 0;
+  }
   uint16_t getAccessoryOutputAddress() const volatile {
     // Address format is weird. See RCN213.
     uint16_t address = (data[0] & 0x3F) | (0x7 & ~((data[1] & 0x70) >> 4));
@@ -66,12 +86,30 @@ struct Message {
     }
   }
 };
-// The current DCC message.
-// This gets filled by interrupts; once its done, the message number (below) is increased by
-// one. The rest of the code then has until the end of the next preamble to read it, before it
-// starts getting overwritten again.
-// A safer double-buffer technique is possible but pointless.
-extern volatile Message message;
+
+// Times for DCC, assuming a 1 MHz timer (which we approximately get with f_cpu = 8Mhz and a
+// prescaler of 8). Without DCCDECODE_EDGE_TIMING, the input gets sampled DCC_WAIT_TIME after
+// each falling edge: still low means a 0, high again means a 1.
+const uint8_t DCC_TIME_ONE = 58;
+const uint8_t DCC_TIME_ZERO = 100;
+const uint8_t DCC_WAIT_TIME = (uint16_t(DCC_TIME_ONE) + uint16_t(DCC_TIME_ZERO)) / 2;
+
+// Half-bit lengths a decoder has to accept according to RCN-210, for receivedEdge().
+// The upper limit for a 0 (10 ms for stretched zeros) is longer than the 8 bit timer can
+// measure, so its overflows get counted with timerOverflowed(); anything from
+// DCC_HALF_BIT_ZERO_MIN up counts as 0.
+const uint8_t DCC_HALF_BIT_ONE_MIN = 52;
+const uint8_t DCC_HALF_BIT_ONE_MAX = 64;
+const uint8_t DCC_HALF_BIT_ZERO_MIN = 90;
+
+// Number of slots in the message queue. One of them always holds the message currently being
+// received, so QUEUE_LENGTH - 1 messages can wait for the main loop. Must be a power of two.
+#ifndef DCCDECODE_QUEUE_LENGTH
+#define DCCDECODE_QUEUE_LENGTH 4
+#endif
+const uint8_t QUEUE_LENGTH = DCCDECODE_QUEUE_LENGTH;
+static_assert((QUEUE_LENGTH & (QUEUE_LENGTH - 1)) == 0, "Queue length must be a power of two");
+static_assert(QUEUE_LENGTH >= 2, "Queue needs room for at least one waiting message");
 
 #ifdef __AVR_ARCH__
 // Called in setup the pin mode and interrupt
@@ -81,10 +119,96 @@ void setupInt0PB2();
 void setupTimer0();
 #endif
 
-// Returns whether a new DCC message has been received since the last time this function was called.
+// Returns whether a received DCC message is waiting to be read with popMessage().
 bool hasNewMessage();
 
+// Takes the oldest received DCC message out of the queue and copies it into out.
+// The messages are filled in by interrupts into a ring buffer; the interrupt never touches a
+// message that hasn't been popped yet, so the copy is always complete. Returns false if there
+// is no message waiting.
+//
+// This is a multi-buffer handoff without sequence numbers or disabled interrupts: The
+// interrupt only publishes a slot (by moving the write index) once the message in it is
+// complete, and only reuses it after popMessage() has moved the read index past it, which
+// happens after the copy. Each index has a single writer and is one byte, so reading it is
+// atomic. A seqlock would only be needed if the interrupt could overwrite a message the main
+// loop is still reading; here it drops the new message instead, see getOverrunCount().
+// Work with the copy; there is no shared message that could change underneath.
+bool popMessage(Message &out);
+
+#ifndef __AVR_ARCH__
+// Host only, for tests: Called by popMessage() while copying, after the length and after
+// each byte, to simulate interrupts arriving in the middle of the copy.
+extern void (*popMessageCopyHook)();
+#endif
+
+// Number of valid messages that had to be dropped because the queue was full, i.e. the main
+// loop did not call popMessage() often enough. Saturates at 255; Statistics::queueOverruns
+// has the full count.
+uint8_t getOverrunCount();
+
+// Packets the interrupt does not even put into the queue, because the main loop would just
+// ignore them anyway: Idle packets, locomotive packets and basic or extended accessory packets
+// for output addresses outside [firstOutputAddress, firstOutputAddress + outputAddressCount).
+// Resets, service mode, broadcast and POM packets always get through.
+// Call again whenever the address window changes. Off by default.
+void setPacketFilter(uint16_t firstOutputAddress, uint16_t outputAddressCount);
+void disablePacketFilter();
+
+// Counters for the health of the DCC signal. They stop at 0xFFFF instead of overflowing.
+struct Statistics {
+  uint16_t deliveredPackets = 0; // Put into the queue
+  uint16_t filteredPackets = 0; // Dropped by the packet filter
+  uint16_t addressedPackets = 0; // Meant for this decoder, see countAddressedPacket()
+  uint16_t preambleRestarts = 0; // 0 bits after fewer than ten 1s
+  uint16_t xorErrors = 0; // Packets with a wrong XOR byte
+  uint16_t lengthOverflows = 0; // Packets longer than Message can store
+  uint16_t queueOverruns = 0; // Valid packets dropped because the queue was full
+};
+
+// Returns a consistent copy of the counters.
+Statistics getStatistics();
+
+// Sets all counters back to 0.
+void resetStatistics();
+
+// Only the main loop knows which packets are meant for this decoder; it calls this for each.
+void countAddressedPacket();
+
 // Exposed for the purposes of unit-testing only
 void receivedBit(bool bitValue);
 
+// Whether the bit that receivedBit() just got ended a packet, valid or not. Command stations
+// with RailCom cut the signal off for about 450 µs after that.
+bool endedPacket(bool bitValue);
+
+#ifdef DCCDECODE_SAMPLE_HOOK
+#ifdef DCCDECODE_EDGE_TIMING
+#error "DCCDECODE_SAMPLE_HOOK needs the sampled input, not DCCDECODE_EDGE_TIMING"
+#endif
+// Implemented by the firmware, called from the timer interrupt right after each sampled bit
+// went through receivedBit(). The next falling edge of the DCC signal is at least
+// 2 * DCC_HALF_BIT_ONE_MIN - DCC_WAIT_TIME µs after the sample (for a 1), or
+// 2 * DCC_HALF_BIT_ZERO_MIN - DCC_WAIT_TIME µs (for a 0), minus the time it took to get here.
+void afterSample(bool bitValue, bool packetEnded);
+#endif
+
+// Called for every edge (rising and falling) of the DCC signal, with the time as 1 MHz
+// timer ticks. Half-bits that are not within the RCN-210 limits for either a 1 or a 0 abort
+// the current packet; pairs of matching half-bits get passed on to receivedBit().
+// Used with DCCDECODE_EDGE_TIMING; exposed for unit-testing and benchmarking.
+void receivedEdge(uint8_t ticks);
+// Called whenever the timer wraps around from 255 to 0, so half-bits of 256 ticks and more
+// still count as 0 instead of wrapping around. Without it, receivedEdge() can only measure
+// half-bits shorter than 256 ticks.
+void timerOverflowed();
+
+// The two decoder cores that receivedBit() can use. The default is a state machine with one
+// state per bit; defining DCCDECODE_TABLE_DECODER at build time selects the one that works
+// on a shift register and only does real work once per byte instead.
+// Exposed for the purposes of unit-testing and benchmarking only. Use only one of them at a
+// time, they share the message queue.
+void receivedBitSwitchDecoder(bool bitValue);
+void receivedBitTableDecoder(bool bitValue);
+
 }
\ No newline at end of file
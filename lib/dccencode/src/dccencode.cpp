@@ -0,0 +1,243 @@
+#include "dccencode.h"
+
+namespace dccencode {
+
+Packet idlePacket() {
+  Packet packet;
+  packet.length = 2;
+  packet.data[0] = 0xFF;
+  packet.data[1] = 0x00;
+  return packet;
+}
+
+Packet resetPacket() {
+  Packet packet;
+  packet.length = 2;
+  packet.data[0] = 0x00;
+  packet.data[1] = 0x00;
+  return packet;
+}
+
+// First two bytes of a basic accessory packet: 10AA-AAAA 1AAA-DAAR, see RCN213.
+static void writeAccessoryAddress(Packet &packet, uint16_t outputAddress, bool direction, bool bitC) {
+  uint16_t fullAddress = outputAddress + 3;
+  uint16_t decoderAddress = fullAddress >> 2;
+  uint8_t port = fullAddress & 0x3;
+
+  packet.data[0] = 0x80 | (decoderAddress & 0x3F);
+  packet.data[1] = 0x80 | ((~decoderAddress >> 2) & 0x70) | (bitC ? 0x08 : 0) | (port << 1) | (direction ? 1 : 0);
+}
+
+Packet basicAccessoryPacket(uint16_t outputAddress, bool direction, bool on) {
+  Packet packet;
+  packet.length = 2;
+  writeAccessoryAddress(packet, outputAddress, direction, on);
+  return packet;
+}
+
+Packet extendedAccessoryPacket(uint16_t outputAddress, uint8_t aspect) {
+  Packet packet;
+  packet.length = 3;
+  // Same address bits as a basic accessory: 10AA-AAAA 0AAA-0AA1 DDDD-DDDD
+  writeAccessoryAddress(packet, outputAddress, true, false);
+  packet.data[1] &= ~0x80;
+  packet.data[2] = aspect;
+  return packet;
+}
+
+Packet accessoryPomWritePacket(uint16_t outputAddress, uint16_t cv, uint8_t value) {
+  Packet packet;
+  packet.length = 5;
+  writeAccessoryAddress(packet, outputAddress, false, true);
+  uint16_t cvIndex = cv - 1;
+  packet.data[2] = 0xEC | ((cvIndex >> 8) & 0x3);
+  packet.data[3] = cvIndex & 0xFF;
+  packet.data[4] = value;
+  return packet;
+}
+
+Packet accessoryXpomWritePacket(uint16_t outputAddress, uint32_t cv, const uint8_t *values, uint8_t count, uint8_t sequence) {
+  Packet packet;
+  packet.length = 6 + count;
+  writeAccessoryAddress(packet, outputAddress, false, true);
+  uint32_t cvIndex = cv - 1;
+  packet.data[2] = 0xEC | (sequence & 0x3);
+  packet.data[3] = (cvIndex >> 16) & 0xFF;
+  packet.data[4] = (cvIndex >> 8) & 0xFF;
+  packet.data[5] = cvIndex & 0xFF;
+  for (uint8_t i = 0; i < count; i++) {
+    packet.data[6 + i] = values[i];
+  }
+  return packet;
+}
+
+Packet serviceModeWritePacket(uint16_t cv, uint8_t value) {
+  Packet packet;
+  packet.length = 3;
+  uint16_t cvIndex = cv - 1;
+  packet.data[0] = 0x7C | ((cvIndex >> 8) & 0x3);
+  packet.data[1] = cvIndex & 0xFF;
+  packet.data[2] = value;
+  return packet;
+}
+
+void BitStream::addBit(bool bitValue) {
+  bits.push_back(bitValue);
+}
+
+void BitStream::addPreamble(uint8_t length) {
+  for (uint8_t i = 0; i < length; i++) {
+    bits.push_back(true);
+  }
+}
+
+void BitStream::addByte(uint8_t aByte) {
+  bits.push_back(false);
+  for (int i = 7; i >= 0; i--) {
+    bits.push_back(aByte & (1 << i));
+  }
+}
+
+void BitStream::addPacketEnd() {
+  bits.push_back(true);
+}
+
+void BitStream::addPacket(const uint8_t *data, uint8_t length, uint8_t preambleLength) {
+  addPreamble(preambleLength);
+  uint8_t checksum = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    addByte(data[i]);
+    checksum ^= data[i];
+  }
+  addByte(checksum);
+  addPacketEnd();
+}
+
+void BitStream::addPacket(const Packet &packet, uint8_t preambleLength) {
+  addPacket(packet.data, packet.length, preambleLength);
+}
+
+void BitStream::feed(void (*receivedBit)(bool bitValue)) const {
+  for (bool bitValue : bits) {
+    receivedBit(bitValue);
+  }
+}
+
+EdgeTrace::EdgeTrace(uint8_t startTicks)
+: now(startTicks)
+{
+  timestamps.push_back(now);
+  overflows.push_back(0);
+}
+
+void EdgeTrace::addHalfBit(uint16_t length) {
+  const uint16_t end = now + length;
+  now = uint8_t(end);
+  timestamps.push_back(now);
+  overflows.push_back(uint8_t(end >> 8));
+}
+
+void EdgeTrace::addBits(const BitStream &bits, const EdgeTiming &timing) {
+  for (bool bitValue : bits.bits) {
+    uint16_t length = bitValue ? timing.oneHalfBit : timing.zeroHalfBit;
+    addHalfBit(length);
+    addHalfBit(length);
+  }
+}
+
+void EdgeTrace::feed(void (*receivedEdge)(uint8_t ticks), void (*timerOverflowed)()) const {
+  for (size_t i = 0; i < timestamps.size(); i++) {
+    for (uint8_t j = 0; timerOverflowed && j < overflows[i]; j++) {
+      timerOverflowed();
+    }
+    receivedEdge(timestamps[i]);
+  }
+}
+
+TrafficGenerator::TrafficGenerator(const TrafficOptions &options)
+: options(options),
+randomState(options.seed ? options.seed : 1)
+{
+}
+
+uint32_t TrafficGenerator::random() {
+  // xorshift32; good enough and the same everywhere
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+Packet TrafficGenerator::nextPacket(PacketType *type) {
+  PacketType packetType = PACKET_TYPE_IDLE;
+  if (repeatsLeft > 0 && random() % 100 >= options.idlePercent) {
+    repeatsLeft -= 1;
+    if (type) {
+      *type = repeatedType;
+    }
+    return repeatedPacket;
+  }
+  if (repeatsLeft == 0 && random() % 100 >= options.idlePercent) {
+    uint32_t totalWeight = uint32_t(options.basicAccessoryWeight) + options.accessoryPomWeight + options.serviceModeWeight;
+    uint32_t choice = totalWeight ? random() % totalWeight : 0;
+    if (choice < options.basicAccessoryWeight) {
+      packetType = PACKET_TYPE_BASIC_ACCESSORY;
+    } else if (choice < uint32_t(options.basicAccessoryWeight) + options.accessoryPomWeight) {
+      packetType = PACKET_TYPE_ACCESSORY_POM;
+    } else {
+      packetType = PACKET_TYPE_SERVICE_MODE;
+    }
+  }
+  if (type) {
+    *type = packetType;
+  }
+
+  uint16_t outputAddress = options.firstOutputAddress + (options.outputAddressCount ? random() % options.outputAddressCount : 0);
+  Packet packet;
+  switch (packetType) {
+    case PACKET_TYPE_BASIC_ACCESSORY:
+      packet = basicAccessoryPacket(outputAddress, random() & 1, random() & 1);
+      break;
+    case PACKET_TYPE_ACCESSORY_POM:
+      packet = accessoryPomWritePacket(outputAddress, 47 + random() % 20, random() & 0xFF);
+      break;
+    case PACKET_TYPE_SERVICE_MODE:
+      packet = serviceModeWritePacket(1 + random() % 66, random() & 0xFF);
+      break;
+    default:
+      return idlePacket();
+  }
+  if (options.repeatCount > 1) {
+    repeatedPacket = packet;
+    repeatedType = packetType;
+    repeatsLeft = options.repeatCount - 1;
+  }
+  return packet;
+}
+
+bool TrafficGenerator::addPacket(BitStream &stream) {
+  PacketType type;
+  Packet packet = nextPacket(&type);
+  packetCount[type] += 1;
+
+  size_t start = stream.size();
+  stream.addPacket(packet, options.preambleLength);
+
+  if (options.bitErrorsPerMillion == 0) {
+    return true;
+  }
+  uint32_t errorsBefore = bitErrors;
+  for (size_t i = start; i < stream.size(); i++) {
+    if (random() % 1000000 < options.bitErrorsPerMillion) {
+      stream.bits[i] = !stream.bits[i];
+      bitErrors += 1;
+    }
+  }
+  if (bitErrors != errorsBefore) {
+    packetsWithErrors += 1;
+    return false;
+  }
+  return true;
+}
+
+}
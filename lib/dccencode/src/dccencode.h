@@ -0,0 +1,147 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace dccencode {
+/*!
+ * Generating DCC data, the counterpart to dccdecode.
+ * This only runs on the host; it is used to drive the decoder in tests and benchmarks.
+ */
+
+const uint8_t DEFAULT_PREAMBLE_LENGTH = 14;
+
+// A DCC packet without the XOR byte, which gets added when encoding it.
+struct Packet {
+  uint8_t length = 0;
+  uint8_t data[10];
+};
+
+// Packet constructors
+Packet idlePacket();
+Packet resetPacket();
+// Basic accessory packet for the given output address (as returned by
+// dccdecode::Message::getAccessoryOutputAddress()). on is the C bit.
+Packet basicAccessoryPacket(uint16_t outputAddress, bool direction, bool on = true);
+// Extended accessory packet setting the signal aspect of the given output address.
+Packet extendedAccessoryPacket(uint16_t outputAddress, uint8_t aspect);
+// Basic accessory POM packet writing a byte to a CV (1-based) of the given output address.
+Packet accessoryPomWritePacket(uint16_t outputAddress, uint16_t cv, uint8_t value);
+// Basic accessory XPOM packet writing one to four bytes to consecutive CVs, starting at cv
+// (1-based). sequence is the SS bits that tell a new command from a repeat.
+Packet accessoryXpomWritePacket(uint16_t outputAddress, uint32_t cv, const uint8_t *values, uint8_t count, uint8_t sequence = 0);
+// Service mode direct CV byte write. cv is 1-based.
+Packet serviceModeWritePacket(uint16_t cv, uint8_t value);
+
+// A sequence of bits, in the form dccdecode::receivedBit() gets them.
+class BitStream {
+public:
+  std::vector<bool> bits;
+
+  void addBit(bool bitValue);
+  void addPreamble(uint8_t length = DEFAULT_PREAMBLE_LENGTH);
+  // Separator (0) followed by the eight data bits
+  void addByte(uint8_t aByte);
+  // The 1 that ends a packet
+  void addPacketEnd();
+  // Complete packet: preamble, data bytes, XOR byte and packet end.
+  void addPacket(const uint8_t *data, uint8_t length, uint8_t preambleLength = DEFAULT_PREAMBLE_LENGTH);
+  void addPacket(const Packet &packet, uint8_t preambleLength = DEFAULT_PREAMBLE_LENGTH);
+
+  size_t size() const { return bits.size(); }
+  void clear() { bits.clear(); }
+
+  // Calls receivedBit for every bit in order.
+  void feed(void (*receivedBit)(bool bitValue)) const;
+};
+
+// Half-bit lengths in µs, which is also the number of timer ticks on the decoder.
+// The defaults are the nominal values from RCN-210.
+struct EdgeTiming {
+  uint8_t oneHalfBit = 58;
+  // Up to 10 ms for stretched zeros
+  uint16_t zeroHalfBit = 100;
+};
+
+// Timestamps of the edges of a DCC signal, in the form dccdecode::receivedEdge() gets them.
+// Like the decoder's timer, they are 8 bit and wrap around; overflows counts how often the
+// timer wrapped around before each edge, for dccdecode::timerOverflowed().
+class EdgeTrace {
+public:
+  std::vector<uint8_t> timestamps;
+  std::vector<uint8_t> overflows;
+
+  EdgeTrace(uint8_t startTicks = 0);
+
+  // One edge after the given number of ticks
+  void addHalfBit(uint16_t length);
+  // Two edges per bit
+  void addBits(const BitStream &bits, const EdgeTiming &timing = EdgeTiming());
+
+  size_t size() const { return timestamps.size(); }
+
+  // Calls receivedEdge for every edge in order, and timerOverflowed, if given, whenever the
+  // timer wraps around in between.
+  void feed(void (*receivedEdge)(uint8_t ticks), void (*timerOverflowed)() = nullptr) const;
+
+private:
+  uint8_t now;
+};
+
+enum PacketType: uint8_t {
+  PACKET_TYPE_IDLE = 0,
+  PACKET_TYPE_BASIC_ACCESSORY,
+  PACKET_TYPE_ACCESSORY_POM,
+  PACKET_TYPE_SERVICE_MODE,
+
+  PACKET_TYPE_COUNT
+};
+
+struct TrafficOptions {
+  uint8_t preambleLength = DEFAULT_PREAMBLE_LENGTH;
+  // Share of idle packets, in percent. The rest is split between the other packet types
+  // according to their weights.
+  uint8_t idlePercent = 50;
+  uint8_t basicAccessoryWeight = 8;
+  uint8_t accessoryPomWeight = 1;
+  uint8_t serviceModeWeight = 1;
+  // Range of accessory output addresses to use
+  uint16_t firstOutputAddress = 1;
+  uint16_t outputAddressCount = 64;
+  // How often command stations send each non-idle packet, like they do for reliability.
+  // The copies come one after the other, with only idle packets in between.
+  uint8_t repeatCount = 1;
+  // Probability that any given bit gets flipped, in flipped bits per million
+  uint32_t bitErrorsPerMillion = 0;
+  uint32_t seed = 1;
+};
+
+// Generates a reproducible random mix of realistic packets.
+class TrafficGenerator {
+public:
+  TrafficGenerator(const TrafficOptions &options);
+
+  // Picks a random packet and appends it to the stream, with bit errors if configured.
+  // Returns whether the packet was encoded without any bit errors.
+  bool addPacket(BitStream &stream);
+  // Picks a random packet (without encoding it).
+  Packet nextPacket(PacketType *type = nullptr);
+
+  // Statistics for everything added so far
+  uint32_t packetCount[PACKET_TYPE_COUNT] = {};
+  uint32_t packetsWithErrors = 0;
+  uint32_t bitErrors = 0;
+
+private:
+  TrafficOptions options;
+  uint32_t randomState;
+  // The last non-idle packet and how many more copies of it are due
+  Packet repeatedPacket;
+  PacketType repeatedType = PACKET_TYPE_IDLE;
+  uint8_t repeatsLeft = 0;
+
+  uint32_t random();
+};
+
+}
@@ -0,0 +1,317 @@
+#include "dccreplay.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace dccreplay {
+
+void Capture::invert() {
+  initialLevel = !initialLevel;
+  for (Edge &edge : edges) {
+    edge.level = !edge.level;
+  }
+}
+
+// Adds a sample, and an edge if the level changed
+static void addSample(Capture &capture, bool &first, bool &level, uint64_t time, bool value) {
+  if (first) {
+    capture.initialLevel = value;
+    level = value;
+    first = false;
+  } else if (value != level) {
+    capture.edges.push_back(Edge{ time, value });
+    level = value;
+  }
+  capture.endTime = time;
+}
+
+static std::vector<std::string> splitCsvLine(const std::string &line) {
+  std::vector<std::string> fields;
+  std::stringstream stream(line);
+  std::string field;
+  while (std::getline(stream, field, ',')) {
+    // Trim spaces, quotes and the \r of Windows line ends
+    size_t start = field.find_first_not_of(" \t\"");
+    size_t end = field.find_last_not_of(" \t\"\r");
+    fields.push_back(start == std::string::npos ? "" : field.substr(start, end - start + 1));
+  }
+  return fields;
+}
+
+static bool startsWithNumber(const std::string &text) {
+  return !text.empty() && (isdigit((unsigned char) text[0]) || text[0] == '.' || text[0] == '-');
+}
+
+// Nanoseconds per unit for "s", "ms", "us", "ns" and so on; 0 if unknown
+static double unitNanoseconds(const std::string &unit) {
+  if (unit == "s") return 1e9;
+  if (unit == "ms") return 1e6;
+  if (unit == "us" || unit == "\xC2\xB5s") return 1e3;
+  if (unit == "ns") return 1;
+  if (unit == "ps") return 1e-3;
+  if (unit == "fs") return 1e-6;
+  return 0;
+}
+
+// "1 MHz", "500 kHz" and so on, as in sigrok's comments
+static double parseSampleRate(const std::string &text) {
+  std::stringstream stream(text);
+  double value = 0;
+  std::string unit;
+  stream >> value >> unit;
+  if (unit == "GHz") return value * 1e9;
+  if (unit == "MHz") return value * 1e6;
+  if (unit == "kHz") return value * 1e3;
+  return value;
+}
+
+bool parseCsv(std::istream &input, Capture &capture, std::string &error, const std::string &channel, double sampleRate) {
+  capture = Capture();
+  std::string line;
+  int timeColumn = -1;
+  int valueColumn = -1;
+  double timeUnit = 1e9;
+  bool first = true;
+  bool level = true;
+  uint64_t sampleIndex = 0;
+  int lineNumber = 0;
+
+  while (std::getline(input, line)) {
+    lineNumber++;
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      continue;
+    }
+    if (line[0] == ';') {
+      const std::string samplerateTag = "Samplerate:";
+      size_t position = line.find(samplerateTag);
+      if (position != std::string::npos && sampleRate == 0) {
+        sampleRate = parseSampleRate(line.substr(position + samplerateTag.size()));
+      }
+      continue;
+    }
+
+    std::vector<std::string> fields = splitCsvLine(line);
+    if (!startsWithNumber(fields[0])) {
+      // Column names
+      for (size_t i = 0; i < fields.size(); i++) {
+        if (fields[i].compare(0, 4, "Time") == 0 || fields[i].compare(0, 4, "time") == 0) {
+          timeColumn = int(i);
+          if (fields[i].find("[ms]") != std::string::npos) timeUnit = 1e6;
+          else if (fields[i].find("[us]") != std::string::npos || fields[i].find("[\xC2\xB5s]") != std::string::npos) timeUnit = 1e3;
+          else if (fields[i].find("[ns]") != std::string::npos) timeUnit = 1;
+        } else if (fields[i] == channel) {
+          valueColumn = int(i);
+        }
+      }
+      if (!channel.empty() && valueColumn < 0) {
+        error = "No column named " + channel;
+        return false;
+      }
+      continue;
+    }
+
+    if (valueColumn < 0) {
+      valueColumn = timeColumn == 0 ? 1 : 0;
+    }
+    if (int(fields.size()) <= valueColumn || (timeColumn >= 0 && int(fields.size()) <= timeColumn)) {
+      error = "Line " + std::to_string(lineNumber) + ": Missing columns";
+      return false;
+    }
+
+    uint64_t time;
+    if (timeColumn >= 0) {
+      time = uint64_t(llround(strtod(fields[timeColumn].c_str(), nullptr) * timeUnit));
+    } else if (sampleRate > 0) {
+      time = uint64_t(llround(sampleIndex * 1e9 / sampleRate));
+    } else {
+      error = "Neither a time column nor a sample rate";
+      return false;
+    }
+    sampleIndex++;
+    addSample(capture, first, level, time, strtol(fields[valueColumn].c_str(), nullptr, 10) != 0);
+  }
+
+  if (first) {
+    error = "No samples";
+    return false;
+  }
+  return true;
+}
+
+bool parseVcd(std::istream &input, Capture &capture, std::string &error, const std::string &channel) {
+  capture = Capture();
+  std::string token;
+  std::string identifier;
+  double timeUnit = 1;
+  uint64_t time = 0;
+  bool first = true;
+  bool level = true;
+  bool inDefinitions = true;
+
+  while (input >> token) {
+    if (token == "$timescale") {
+      // "1 us" or "1us"
+      std::string scale;
+      while (input >> token && token != "$end") {
+        scale += token;
+      }
+      size_t unitStart = scale.find_first_not_of("0123456789.");
+      timeUnit = atof(scale.substr(0, unitStart).c_str()) * unitNanoseconds(unitStart == std::string::npos ? "" : scale.substr(unitStart));
+      if (timeUnit <= 0) {
+        error = "Unknown timescale " + scale;
+        return false;
+      }
+    } else if (token == "$var") {
+      // $var wire 1 ! D0 $end
+      std::string type, size, id, name;
+      input >> type >> size >> id >> name;
+      if (size == "1" && identifier.empty() && (channel.empty() || name == channel)) {
+        identifier = id;
+      }
+      while (input >> token && token != "$end") {}
+    } else if (token == "$enddefinitions") {
+      inDefinitions = false;
+      if (identifier.empty()) {
+        error = channel.empty() ? "No 1 bit variable" : "No 1 bit variable named " + channel;
+        return false;
+      }
+      while (input >> token && token != "$end") {}
+    } else if (token == "$dumpvars" || token == "$end") {
+      // The initial values in $dumpvars are normal value changes
+    } else if (token[0] == '$') {
+      // $comment, $date, $version, $scope and so on
+      while (input >> token && token != "$end") {}
+    } else if (inDefinitions) {
+      continue;
+    } else if (token[0] == '#') {
+      time = uint64_t(llround(strtod(token.c_str() + 1, nullptr) * timeUnit));
+      if (!first) {
+        capture.endTime = time;
+      }
+    } else if (token[0] == 'b' || token[0] == 'B' || token[0] == 'r' || token[0] == 'R') {
+      // Vector value, "b1 !"; the identifier is the next token
+      std::string id;
+      input >> id;
+      if (id == identifier) {
+        addSample(capture, first, level, time, token.size() > 1 && token.back() == '1');
+      }
+    } else if (token.substr(1) == identifier) {
+      // Scalar value, "1!"
+      if (token[0] == '0' || token[0] == '1') {
+        addSample(capture, first, level, time, token[0] == '1');
+      }
+    }
+  }
+
+  if (first) {
+    error = "No values for the signal";
+    return false;
+  }
+  return true;
+}
+
+bool readCapture(const std::string &path, Capture &capture, std::string &error, const std::string &channel) {
+  std::ifstream file(path);
+  if (!file) {
+    error = "Can't open " + path;
+    return false;
+  }
+  const std::string vcdExtension = ".vcd";
+  if (path.size() >= vcdExtension.size() && path.compare(path.size() - vcdExtension.size(), vcdExtension.size(), vcdExtension) == 0) {
+    return parseVcd(file, capture, error, channel);
+  }
+  return parseCsv(file, capture, error, channel);
+}
+
+const char *inputName(Input input) {
+  switch (input) {
+    case INPUT_SAMPLED_SWITCH_DECODER: return "sampled, switch decoder";
+    case INPUT_SAMPLED_TABLE_DECODER: return "sampled, table decoder";
+    case INPUT_EDGE_TIMING: return "edge timing";
+    default: return "?";
+  }
+}
+
+// Gets the decoder to wait for a preamble, whatever the previous capture left it in
+static void resetDecoder() {
+  // Zeros end any packet at the latest when it gets too long; the glitch resets the edge timing
+  for (int i = 0; i < 100; i++) {
+    dccdecode::receivedBitSwitchDecoder(false);
+    dccdecode::receivedBitTableDecoder(false);
+  }
+  dccdecode::receivedEdge(0);
+  dccdecode::receivedEdge(1);
+  dccdecode::Message message;
+  while (dccdecode::popMessage(message)) {}
+  dccdecode::resetStatistics();
+}
+
+static void takeMessages(Result &result, uint64_t time) {
+  DecodedPacket packet;
+  packet.time = time;
+  while (dccdecode::popMessage(packet.message)) {
+    result.packets.push_back(packet);
+  }
+}
+
+Result replay(const Capture &capture, Input input) {
+  Result result;
+  resetDecoder();
+  auto start = std::chrono::steady_clock::now();
+
+  const std::vector<Edge> &edges = capture.edges;
+  if (input == INPUT_EDGE_TIMING) {
+    uint64_t lastWrap = 0;
+    for (const Edge &edge : edges) {
+      // Timer0 ticks once per microsecond and wraps around
+      const uint64_t wrap = edge.time / 1000 / 256;
+      // Only the first two overflows make a difference
+      for (uint64_t i = lastWrap; i < wrap && i < lastWrap + 2; i++) {
+        dccdecode::timerOverflowed();
+      }
+      lastWrap = wrap;
+      dccdecode::receivedEdge(uint8_t(edge.time / 1000));
+      result.decoderCalls++;
+      takeMessages(result, edge.time);
+    }
+  } else {
+    void (*receivedBit)(bool) = input == INPUT_SAMPLED_TABLE_DECODER ? dccdecode::receivedBitTableDecoder : dccdecode::receivedBitSwitchDecoder;
+    const uint64_t waitTime = uint64_t(dccdecode::DCC_WAIT_TIME) * 1000;
+    for (size_t i = 0; i < edges.size(); i++) {
+      if (edges[i].level) {
+        continue;
+      }
+      // Falling edge: the timer starts, and the input gets sampled when it fires. Another
+      // falling edge before that restarts the timer.
+      const uint64_t sampleTime = edges[i].time + waitTime;
+      if (sampleTime > capture.endTime) {
+        break;
+      }
+      bool level = false;
+      bool restarted = false;
+      for (size_t j = i + 1; j < edges.size() && edges[j].time <= sampleTime; j++) {
+        level = edges[j].level;
+        restarted = restarted || !edges[j].level;
+      }
+      if (restarted) {
+        continue;
+      }
+      receivedBit(level);
+      result.decoderCalls++;
+      takeMessages(result, sampleTime);
+    }
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  result.hostSeconds = std::chrono::duration<double>(end - start).count();
+  result.statistics = dccdecode::getStatistics();
+  return result;
+}
+
+}
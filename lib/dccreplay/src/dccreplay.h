@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <istream>
+#include <string>
+#include <vector>
+#include <dccdecode.h>
+
+namespace dccreplay {
+/*!
+ * Replaying recorded DCC signals, e.g. logic analyzer captures, through dccdecode.
+ * This only runs on the host; it is used by tools/dccreplay and the replay tests.
+ */
+
+// A change of the DCC input level, in nanoseconds since the start of the capture.
+struct Edge {
+  uint64_t time;
+  bool level;
+};
+
+struct Capture {
+  bool initialLevel = true;
+  std::vector<Edge> edges;
+  // Time of the last sample, which may be after the last edge
+  uint64_t endTime = 0;
+
+  // For probes on the other rail. DCC works either way, but the sampling points move.
+  void invert();
+};
+
+// Reads a sigrok/PulseView CSV export. Lines starting with ';' are comments, and a line that
+// doesn't start with a number names the columns. With a column whose name starts with "Time"
+// (in seconds, unless the name contains [ms], [us] or [ns]), each row is a sample at that
+// time, so exports with only the changes work as well. Otherwise the rows are consecutive
+// samples at sampleRate, or at the rate from a "; Samplerate: 1 MHz" comment.
+// The DCC signal is the column named channel, or the first one that isn't the time.
+bool parseCsv(std::istream &input, Capture &capture, std::string &error, const std::string &channel = "", double sampleRate = 0);
+
+// Reads a value change dump, e.g. a sigrok/PulseView VCD export. The DCC signal is the 1 bit
+// variable named channel, or the first one.
+bool parseVcd(std::istream &input, Capture &capture, std::string &error, const std::string &channel = "");
+
+// parseVcd() for files ending in .vcd, parseCsv() for anything else
+bool readCapture(const std::string &path, Capture &capture, std::string &error, const std::string &channel = "");
+
+// How the capture gets into the decoder
+enum Input: uint8_t {
+  // receivedBit(), with the input sampled DCC_WAIT_TIME after each falling edge like the
+  // default firmware does; one variant per decoder core
+  INPUT_SAMPLED_SWITCH_DECODER = 0,
+  INPUT_SAMPLED_TABLE_DECODER,
+  // receivedEdge() for every edge, with the 8 bit 1 MHz timer of DCCDECODE_EDGE_TIMING
+  INPUT_EDGE_TIMING,
+
+  INPUT_COUNT
+};
+
+const char *inputName(Input input);
+
+struct DecodedPacket {
+  // When the packet came out of the decoder, in nanoseconds
+  uint64_t time;
+  dccdecode::Message message;
+};
+
+struct Result {
+  std::vector<DecodedPacket> packets;
+  // Note that the counters saturate at 0xFFFF, which long captures may reach
+  dccdecode::Statistics statistics;
+  // Calls of receivedBit() or receivedEdge()
+  uint64_t decoderCalls = 0;
+  // Time the replay took on the host
+  double hostSeconds = 0;
+};
+
+// Runs the whole capture through the decoder as fast as possible, taking every message out
+// right away. The decoder state and statistics get reset first. The packet filter is left
+// as it is, which is off unless someone turned it on.
+Result replay(const Capture &capture, Input input);
+
+}
@@ -1,8 +1,51 @@
 #include "animation.h"
 
+#include "flash.h"
+#ifdef ANIMATION_EASING
+
+// Smoothstep curve, 255 * (3x^2 - 2x^3) for x = index/64
+const uint8_t EASING_STEPS = 64;
+const uint8_t easing[EASING_STEPS] PROGMEM = {
+    0, 0, 1, 2, 3, 4, 6, 8, 11, 14, 17, 20, 24, 27, 31, 35,
+    40, 44, 49, 54, 59, 64, 70, 75, 81, 86, 92, 98, 104, 110, 116, 122,
+    128, 133, 139, 145, 151, 157, 163, 169, 174, 180, 185, 191, 196, 201, 206, 211,
+    215, 220, 224, 228, 231, 235, 238, 241, 244, 247, 249, 251, 252, 253, 254, 255,
+};
+#endif
+
+#ifndef __AVR_ARCH__
+animation::OperationCounts animation::operationCounts;
+#endif
+
+void PhaseStepper::reset(uint8_t target, uint8_t steps, uint8_t timestep) {
+    ANIMATION_COUNT(divisions, 2);
+    stepValue = target / steps;
+    stepRemainder = target % steps;
+    if (timestep == 0) {
+        value = 0;
+        remainder = 0;
+    } else {
+        ANIMATION_COUNT(multiplications, 1);
+        ANIMATION_COUNT(divisions, 2);
+        const uint16_t distance = uint16_t(timestep) * target;
+        value = distance / steps;
+        remainder = distance % steps;
+    }
+}
+
+void PhaseStepper::step(uint8_t steps) {
+    value += stepValue;
+    remainder += stepRemainder;
+    if (remainder >= steps) {
+        remainder -= steps;
+        value++;
+    }
+}
+
 AnimationPlayer::AnimationPlayer(uint8_t initialAnimation) {
     phaseTimestep = 0;
     phaseIndex = initialAnimation;
+    paletteGeneration = colors::paletteGeneration;
 }
 
 void AnimationPlayer::setAnimation(uint8_t index) {
@@ -10,45 +53,119 @@ void AnimationPlayer::setAnimation(uint8_t index) {
     phaseIndex = index;
 }
 
-const AnimationPhase *AnimationPlayer::getCurrentPhase() {
-    const AnimationPhase *currentPhase = &animations[phaseIndex];
-    while (currentPhase->length < 0) {
-        phaseIndex += currentPhase->length;
-        currentPhase = &animations[phaseIndex];
-    }
-    return currentPhase;
-}
-
 bool AnimationPlayer::isComplete() {
-    return (getCurrentPhase()->flags & 0x80) != 0;
+    return (pgm_read_byte(&animations[phaseIndex].flags) & 0x80) != 0;
 }
 
 static const uint8_t *select(const uint8_t *a, const uint8_t *b, uint8_t index) {
     switch (index) {
         case 0: return a;
         case 1: return b;
-        default: return (const uint8_t*) &colors::colorValues[index-2];
+        default: return (const uint8_t*) &colors::outputColorValues[index-2];
     }
 }
 
-static uint8_t blend(uint8_t start, uint8_t end, uint8_t alpha, uint8_t alphaScale) {
-    return uint8_t(int16_t(alpha) * int16_t(end - start) / int16_t(alphaScale)) + start;
+static uint8_t distance(uint8_t start, uint8_t end) {
+    return end >= start ? end - start : start - end;
 }
 
-void AnimationPlayer::updateColor(const uint8_t *a, const uint8_t *b, uint8_t *out) {
-    const AnimationPhase *currentPhase = getCurrentPhase();
-    const uint8_t phaseLength = currentPhase->length;
+#ifdef ANIMATION_EASING
+void AnimationPlayer::setupPhase(uint8_t phaseLength) {
+    paletteGeneration = colors::paletteGeneration;
+    easingIndex.reset(EASING_STEPS, phaseLength, phaseTimestep);
+}
+#else
+void AnimationPlayer::setupPhase(const uint8_t *start, const uint8_t *end, uint8_t phaseLength) {
+    paletteGeneration = colors::paletteGeneration;
+    for (int i = 0; i < 3; i++) {
+        channels[i].reset(distance(start[i], end[i]), phaseLength, phaseTimestep);
+    }
+}
+#endif
+
+void AnimationPlayer::currentColor(const uint8_t *a, const uint8_t *b, uint8_t *out) {
+    ANIMATION_COUNT(playerUpdates, 1);
+    const AnimationPhase currentPhase = flash::read(&animations[phaseIndex]);
 
-    const uint8_t *inputStart = select(a, b, (currentPhase->flags >> 4) & 0x7);
-    const uint8_t *inputEnd = select(a, b, currentPhase->flags & 0x7);
+    const uint8_t *inputStart = select(a, b, (currentPhase.flags >> 4) & 0x7);
+    const uint8_t *inputEnd = select(a, b, currentPhase.flags & 0x7);
+
+    // Dividing only happens here, at the start of a phase (also after setAnimation()), or if
+    // the palette changed during it.
+    if (phaseTimestep == 0 || paletteGeneration != colors::paletteGeneration) {
+#ifdef ANIMATION_EASING
+        setupPhase(currentPhase.length);
+#else
+        setupPhase(inputStart, inputEnd, currentPhase.length);
+#endif
+    }
 
+#ifdef ANIMATION_EASING
+    const uint8_t alpha = pgm_read_byte(&easing[easingIndex.value]);
+    ANIMATION_COUNT(multiplications, 3);
     for (int i = 0; i < 3; i++) {
-        out[i] = blend(inputStart[i], inputEnd[i], phaseTimestep, phaseLength);
+        const uint8_t offset = (uint16_t(distance(inputStart[i], inputEnd[i])) * alpha) >> 8;
+        out[i] = inputEnd[i] >= inputStart[i] ? inputStart[i] + offset : inputStart[i] - offset;
     }
+#else
+    // Same result as start + t * (end - start) / length, rounded towards zero
+    for (int i = 0; i < 3; i++) {
+        out[i] = inputEnd[i] >= inputStart[i] ? inputStart[i] + channels[i].value : inputStart[i] - channels[i].value;
+    }
+#endif
+}
+
+void AnimationPlayer::dividedColor(const uint8_t *a, const uint8_t *b, uint8_t *out) const {
+    const AnimationPhase currentPhase = flash::read(&animations[phaseIndex]);
+
+    const uint8_t *inputStart = select(a, b, (currentPhase.flags >> 4) & 0x7);
+    const uint8_t *inputEnd = select(a, b, currentPhase.flags & 0x7);
 
+#ifdef ANIMATION_EASING
+    ANIMATION_COUNT(multiplications, 4);
+    ANIMATION_COUNT(divisions, 1);
+    const uint8_t alpha = pgm_read_byte(&easing[uint16_t(phaseTimestep) * EASING_STEPS / currentPhase.length]);
+#else
+    ANIMATION_COUNT(multiplications, 3);
+    ANIMATION_COUNT(divisions, 3);
+#endif
+    for (int i = 0; i < 3; i++) {
+#ifdef ANIMATION_EASING
+        const uint8_t offset = (uint16_t(distance(inputStart[i], inputEnd[i])) * alpha) >> 8;
+#else
+        const uint8_t offset = uint16_t(phaseTimestep) * distance(inputStart[i], inputEnd[i]) / currentPhase.length;
+#endif
+        out[i] = inputEnd[i] >= inputStart[i] ? inputStart[i] + offset : inputStart[i] - offset;
+    }
+}
+
+void AnimationPlayer::nextTimestep(uint8_t phaseLength) {
     phaseTimestep += 1;
-    if (currentPhase->length != 127 && phaseTimestep >= phaseLength) {
+    if (phaseTimestep >= phaseLength) {
         phaseTimestep = 0;
-        phaseIndex++;
+        phaseIndex = pgm_read_byte(&animations[phaseIndex].next);
     }
-}
\ No newline at end of file
+}
+
+void AnimationPlayer::advance() {
+    const uint8_t phaseLength = pgm_read_byte(&animations[phaseIndex].length);
+#ifdef ANIMATION_EASING
+    easingIndex.step(phaseLength);
+#else
+    for (int i = 0; i < 3; i++) {
+        channels[i].step(phaseLength);
+    }
+#endif
+    nextTimestep(phaseLength);
+}
+
+void AnimationPlayer::skip() {
+    // Stale, so the next currentColor() sets up the phase again
+    paletteGeneration = colors::paletteGeneration - 1;
+    nextTimestep(pgm_read_byte(&animations[phaseIndex].length));
+}
+
+void AnimationPlayer::updateColor(const uint8_t *a, const uint8_t *b, uint8_t *out) {
+    currentColor(a, b, out);
+    advance();
+}
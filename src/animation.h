@@ -1,3 +1,5 @@
+#pragma once
+
 #include <stdint.h>
 #include <colors.h>
 
@@ -10,26 +12,201 @@ struct AnimationPhase {
      * Values:
      * 0: Color a (of the ones passed to updateColor)
      * 1: Color b (of the ones passed to updateColor)
-     * anything higher: colorValues[index-2]
+     * anything higher: outputColorValues[index-2]
+     *
+     * Usually written with animation::compile() below instead of by hand.
      */
 
-    int8_t length; // 0: Infinite, do not update colors; negative: Offset to jump back to, also does not update colors
+    uint8_t length; // Number of timesteps, 1 to animation::MAX_PHASE_LENGTH
     uint8_t flags; // Bit 7: "Is complete here", Bits 4-6: select first color (at start), Bits 0-3: select second color (at end)
+    uint8_t next; // Index of the phase to continue with afterwards
 };
 
-// Must be defined elsewhere
-const extern AnimationPhase animations[];
-extern colors::ColorRGB colors::colorValues[];
+// Must be defined elsewhere, and must be in flash (PROGMEM)
+extern const AnimationPhase *const animations;
+extern colors::ColorRGB colors::outputColorValues[];
+
+namespace animation {
+    // Where a phase takes a color from, see AnimationPhase
+    struct Selector {
+        uint8_t index;
+    };
+    // The colors passed to AnimationPlayer::updateColor()
+    constexpr Selector A = { 0 };
+    constexpr Selector B = { 1 };
+    // A color from colors::outputColorValues
+    constexpr Selector palette(colors::ColorName color) {
+        return { uint8_t(2 + color) };
+    }
+    static_assert(2 + colors::COUNT <= 8, "Color selectors have to fit into three bits");
+
+    // Longer phases would overflow PhaseStepper
+    const uint8_t MAX_PHASE_LENGTH = 127;
+
+    // Values for Step::next
+    const uint8_t NEXT_STEP = 0xFF;
+    const uint8_t SAME_STEP = 0xFE;
+
+    // One phase of an animation as written in the source. The animation continues with the
+    // following step, or with the one given by thenRepeatFrom().
+    struct Step {
+        uint8_t length;
+        Selector from;
+        Selector to;
+        bool complete;
+        uint8_t next; // Index within the same animation, or NEXT_STEP or SAME_STEP
+
+        // isComplete() is true while this step is playing
+        constexpr Step completed() const {
+            Step result = *this;
+            result.complete = true;
+            return result;
+        }
+
+        // Continues with the given step (counted from 0) of the same animation afterwards
+        constexpr Step thenRepeatFrom(uint8_t step) const {
+            Step result = *this;
+            result.next = step;
+            return result;
+        }
+    };
+
+    // Blends from one color to the other over length timesteps
+    constexpr Step fade(uint8_t length, Selector from, Selector to) {
+        return { length, from, to, false, NEXT_STEP };
+    }
+
+    // Shows one color for length timesteps
+    constexpr Step show(uint8_t length, Selector color) {
+        return fade(length, color, color);
+    }
+
+    // Shows one color until the animation gets changed; the animation is complete then
+    constexpr Step hold(Selector color) {
+        return { MAX_PHASE_LENGTH, color, color, true, SAME_STEP };
+    }
+
+    template<uint8_t PhaseCount, uint8_t AnimationCount>
+    struct Table {
+        AnimationPhase phases[PhaseCount] = {};
+        // Index of the first phase for each animation, in the order passed to compile()
+        uint8_t start[AnimationCount] = {};
 
+        // Check these with static_assert
+        bool colorsValid = true; // Every selector refers to a color that exists
+        bool lengthsValid = true; // No phase is empty or longer than MAX_PHASE_LENGTH
+        bool jumpsValid = true; // No animation repeats from a step it does not have or runs past its end
+
+        template<unsigned StepCount>
+        constexpr void add(uint8_t animation, uint8_t &phaseIndex, const Step (&steps)[StepCount]) {
+            const uint8_t first = phaseIndex;
+            start[animation] = first;
+            for (uint8_t i = 0; i < StepCount; i++) {
+                const Step &step = steps[i];
+                if (step.length == 0 || step.length > MAX_PHASE_LENGTH) {
+                    lengthsValid = false;
+                }
+                if (step.from.index >= 2 + colors::COUNT || step.to.index >= 2 + colors::COUNT) {
+                    colorsValid = false;
+                }
+
+                uint8_t next = first;
+                if (step.next == NEXT_STEP) {
+                    jumpsValid = jumpsValid && i + 1u < StepCount;
+                    next = first + i + 1;
+                } else if (step.next == SAME_STEP) {
+                    next = first + i;
+                } else {
+                    jumpsValid = jumpsValid && step.next < StepCount;
+                    next = first + step.next;
+                }
+
+                phases[phaseIndex++] = {
+                    step.length,
+                    uint8_t((step.complete ? 0x80 : 0x00) | ((step.from.index & 0x7) << 4) | (step.to.index & 0x7)),
+                    next
+                };
+            }
+        }
+    };
+
+    // Turns animations, each an array of steps, into a single table with all jumps resolved.
+    template<unsigned... StepCounts>
+    constexpr Table<(StepCounts + ...), sizeof...(StepCounts)> compile(const Step (&...animations)[StepCounts]) {
+        Table<(StepCounts + ...), sizeof...(StepCounts)> table;
+        uint8_t animation = 0;
+        uint8_t phaseIndex = 0;
+        (table.add(animation++, phaseIndex, animations), ...);
+        return table;
+    }
+}
+
+#ifndef __AVR_ARCH__
+namespace animation {
+    // What calculating frames costs, counted on the host for the benchmarks. The ATtiny has
+    // neither a divide nor a multiply instruction, so these are the expensive parts there.
+    struct OperationCounts {
+        uint32_t playerUpdates = 0; // AnimationPlayer::updateColor()
+        uint32_t divisions = 0; // 8 or 16 bit divisions and remainders
+        uint32_t multiplications = 0; // 8x8 bit
+    };
+    extern OperationCounts operationCounts;
+}
+#define ANIMATION_COUNT(counter, amount) (animation::operationCounts.counter += (amount))
+#else
+#define ANIMATION_COUNT(counter, amount)
+#endif
+
+// Goes from 0 to a target value in a given number of steps without dividing on every step.
+// After step t, value is t * target / steps, rounded towards zero.
+struct PhaseStepper {
+    uint8_t value;
+    uint8_t remainder;
+    uint8_t stepValue;
+    uint8_t stepRemainder;
+
+    void reset(uint8_t target, uint8_t steps, uint8_t timestep);
+    void step(uint8_t steps);
+};
+
+// Phases blend linearly by default. Build with -DANIMATION_EASING to ease in and out of each
+// phase with a curve stored in flash instead.
 class AnimationPlayer {
     uint8_t phaseTimestep;
     uint8_t phaseIndex;
 
-    const AnimationPhase *getCurrentPhase();
+    // colors::paletteGeneration as of the last setup
+    uint8_t paletteGeneration;
+#ifdef ANIMATION_EASING
+    PhaseStepper easingIndex;
+#else
+    // Distance from the start color, per channel
+    PhaseStepper channels[3];
+#endif
+
+#ifdef ANIMATION_EASING
+    void setupPhase(uint8_t phaseLength);
+#else
+    void setupPhase(const uint8_t *start, const uint8_t *end, uint8_t phaseLength);
+#endif
+    void nextTimestep(uint8_t phaseLength);
 public:
     AnimationPlayer(uint8_t initialAnimation);
 
     void setAnimation(uint8_t index);
     bool isComplete();
+    // The player divides only when a phase starts or the palette changed (see
+    // colors::paletteGeneration), so a and b may only change together with setAnimation().
     void updateColor(const uint8_t *a, const uint8_t *b, uint8_t *out);
+
+    // updateColor() in two halves, for players that more than one user reads per timestep:
+    // the color of the current timestep, then the step to the next one. Call currentColor()
+    // at least once before each advance(). skip() steps without a currentColor() before,
+    // for timesteps nobody looked at; it costs a setup the next time.
+    void currentColor(const uint8_t *a, const uint8_t *b, uint8_t *out);
+    void advance();
+    void skip();
+    // What currentColor() would give for a and b, calculated from scratch, for colors that
+    // change during a phase. Multiplies and divides on every call.
+    void dividedColor(const uint8_t *a, const uint8_t *b, uint8_t *out) const;
 };
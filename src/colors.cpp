@@ -1,10 +1,12 @@
 #include "colors.h"
+#include "configuration.h"
+#include "eepromlayout.h"
 
-#include <avr/eeprom.h>
-#include <string.h>
+#include "flash.h"
+#include "hal.h"
 
 namespace colors {
-    const ColorRGB defaultColorValues[] = {
+    const ColorRGB defaultColorValues[] PROGMEM = {
         ColorRGB(255, 0, 0), // RED - 2 - cv 48,49,50
         ColorRGB(0, 255, 0), // GREEN - 3 - cv 51,52,53
         ColorRGB(127, 127, 0), // YELLOW - 4 - cv 54,55,56
@@ -13,24 +15,37 @@ namespace colors {
     };
 
     ColorRGB colorValues[ sizeof(defaultColorValues)/sizeof(ColorRGB) ];
-    ColorRGB colorValuesStored[ sizeof(defaultColorValues)/sizeof(ColorRGB) ] EEMEM;
+    ColorRGB outputColorValues[ sizeof(defaultColorValues)/sizeof(ColorRGB) ];
+    uint8_t paletteGeneration = 0;
 
     void loadColorsFromEeprom() {
-        eeprom_read_block(colorValues, colorValuesStored, sizeof(defaultColorValues));
+        hal::eepromReadBlock(colorValues, eepromlayout::stored.colors, sizeof(defaultColorValues));
+        updateOutputColors();
     }
 
     void restoreDefaultColorsToEeprom() {
-        eeprom_update_block(defaultColorValues, colorValuesStored, sizeof(defaultColorValues));
-        memcpy(colorValues, defaultColorValues, sizeof(defaultColorValues));
+        memcpy_P(colorValues, defaultColorValues, sizeof(defaultColorValues));
+        hal::eepromUpdateBlock(colorValues, eepromlayout::stored.colors, sizeof(defaultColorValues));
+        updateOutputColors();
     }
 
-    uint8_t getColorValue(uint8_t index) {
-        return ((uint8_t *) colorValues)[index];
+    static uint8_t applyBrightness(uint8_t value) {
+        return (uint16_t(value) * config::values.brightness) / config::BRIGHTNESS_MAX;
     }
 
-    void writeColorValueToEeprom(uint8_t index, uint8_t value) {
-        eeprom_update_byte(&(((uint8_t *) colorValuesStored)[index]), value);
-        ((uint8_t *) colorValues)[index] = value;
+    void updateOutputColors() {
+        for (uint8_t i = 0; i < sizeof(defaultColorValues)/sizeof(ColorRGB); i++) {
+            ColorRGB color = colorValues[i];
+            if (config::values.brightness < config::BRIGHTNESS_MAX) {
+                color = ColorRGB(applyBrightness(color.r), applyBrightness(color.g), applyBrightness(color.b));
+            }
+            if (config::values.colorOrder == config::Configuration::COLOR_ORDER_GRB) {
+                // Swap colors for WS2812
+                color = ColorRGB(color.g, color.r, color.b);
+            }
+            outputColorValues[i] = color;
+        }
+        paletteGeneration++;
     }
 }
 
@@ -23,9 +23,20 @@ namespace colors {
         constexpr ColorRGB(uint8_t red, uint8_t green, uint8_t blue): r(red), g(green), b(blue) {} 
     };
 
-    // The actually used values for the colors given by the color names.
+    // The actually used values for the colors given by the color names; their copy in the
+    // EEPROM is in eepromlayout.h. Programming goes through cvtable.cpp.
     extern colors::ColorRGB colorValues[];
 
+    // colorValues with the brightness and the channel order of the LEDs applied, i.e. exactly
+    // what gets sent to the LEDs. Despite the names, r, g and b are the first, second and
+    // third byte sent. Kept up to date by the functions below; everything else has to call
+    // updateOutputColors() when the brightness or color order changes.
+    extern colors::ColorRGB outputColorValues[];
+
+    // Counts up (and wraps around) whenever outputColorValues change, so AnimationPlayer
+    // notices without keeping a copy of the colors it blends.
+    extern uint8_t paletteGeneration;
+
     // Ensure the sizes fit so we can work properly with the eeprom
     static_assert(sizeof(ColorRGB) == 3);
     static_assert(sizeof(ColorRGB[2]) == 6);
@@ -39,14 +50,7 @@ namespace colors {
      */
     void restoreDefaultColorsToEeprom();
     /*!
-     * For programming mode, value reading: The color at the index.
-     * The index is i*3 + field, where i is the ColorName value, and field is 0 for r, 1 for g, 2 for b
-     */
-    uint8_t getColorValue(uint8_t index);
-    /*!
-     * For programming mode, value writing: Change the color at the index.
-     * The index is i*3 + field, where i is the ColorName value, and field is 0 for r, 1 for g, 2 for b
-     * Also updates the internal color used.
+     * Recalculates outputColorValues from colorValues and the current configuration.
      */
-    void writeColorValueToEeprom(uint8_t index, uint8_t color);
+    void updateOutputColors();
 }
\ No newline at end of file
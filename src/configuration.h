@@ -7,11 +7,46 @@ namespace config {
 const uint8_t CV_INDEX_BRIGHTNESS = 47;
 const uint8_t BRIGHTNESS_MAX = 100;
 
+// Color values, r, g and b for each colors::ColorName
+const uint8_t CV_INDEX_COLOR_BASE = 48;
+
 const uint8_t CV_INDEX_COLOR_ORDER = 64;
 const uint8_t CV_INDEX_NUM_SIGNAL_HEADS = 65;
-const uint8_t MAX_NUM_SIGNAL_HEADS = 3;
 const uint8_t CV_INDEX_WORKAROUNDS = 66;
 
+// Build with e.g. -DSIGNALBANK_MAX_HEADS=8 -DSIGNALBANK_LEDS_PER_HEAD=2 for larger signals,
+// set in the [signalbank] section of platformio.ini so EEPROM images match the firmware.
+// The signal bank may use 256 bytes of RAM (see main.cpp), which is 3 bytes plus 20 per head
+// plus 3 per LED: up to 8 heads with two LEDs each, or 11 with one. 16 heads only fit with
+// -DANIMATION_EASING, which makes each head 8 bytes smaller.
+#ifndef SIGNALBANK_MAX_HEADS
+#define SIGNALBANK_MAX_HEADS 3
+#endif
+#ifndef SIGNALBANK_LEDS_PER_HEAD
+#define SIGNALBANK_LEDS_PER_HEAD 1
+#endif
+const uint8_t MAX_NUM_SIGNAL_HEADS = SIGNALBANK_MAX_HEADS;
+const uint8_t LEDS_PER_HEAD = SIGNALBANK_LEDS_PER_HEAD;
+const uint8_t MAX_NUM_LEDS = MAX_NUM_SIGNAL_HEADS * LEDS_PER_HEAD;
+
+// Extended accessory packets set a whole signal head at once, with one output address per
+// head. Their aspect number selects one of these CVs, each with a colors::ColorName in the low
+// bits and ASPECT_BIT_FLASHING. Aspects without a CV are ignored.
+const uint8_t CV_INDEX_ASPECT_BASE = 80;
+const uint8_t ASPECT_COUNT = 8;
+const uint8_t ASPECT_COLOR_MASK = 0x03;
+const uint8_t ASPECT_BIT_FLASHING = (1 << 7);
+const uint8_t ASPECT_VALID_BITS = ASPECT_COLOR_MASK | ASPECT_BIT_FLASHING;
+
+// Diagnostics: The dccdecode::Statistics counters, two CVs each (low byte first). Read-only,
+// but writing 0 to any of them resets all counters.
+const uint8_t CV_INDEX_STATISTICS_BASE = 112;
+
+// LED mapping: One CV per LED in the chain, with the index of the signal head it shows (0 is
+// the top one) or LED_MAPPING_DARK. By default, each head has LEDS_PER_HEAD LEDs in a row.
+const uint8_t CV_INDEX_LED_MAPPING_BASE = 129;
+const uint8_t LED_MAPPING_DARK = 0xFE;
+
 // CV29: base configuration
 // In this decoder, CV29 isn't writable.
 const uint8_t CONFIGURATION_BIT_28_SPEED_STEPS = (1 << 1); // Only relevant in locomotive mode
@@ -24,7 +59,8 @@ const uint8_t DEFAULT_CONFIGURATION = CONFIGURATION_BIT_IS_ACCESSORY_DECODER | C
 const uint8_t WORKAROUND_BIT_POM_ADDRESSING = (1 << 0);
 const uint8_t WORKAROUND_VALID_BITS = WORKAROUND_BIT_POM_ADDRESSING;
 
-struct Configuration {
+// Packed, so the EEPROM layout (eepromlayout.h) is the same on the AVR and the host
+struct __attribute__((packed)) Configuration {
     uint16_t address;
     uint8_t brightness;
 
@@ -37,16 +73,21 @@ struct Configuration {
     uint8_t activeSignalHeads;
 
     uint8_t workarounds;
+
+    uint8_t ledMapping[MAX_NUM_LEDS];
+
+    // CV31 and 32 for access to extended data
+    // Not really used at the moment
+    uint8_t extendedRangeHigh;
+    uint8_t extendedRangeLow;
+
+    uint8_t aspects[ASPECT_COUNT];
 };
 
+// The CVs themselves are in cvtable.cpp, the copy in the EEPROM in eepromlayout.h
 extern Configuration values;
 
 void loadConfiguration();
 void resetConfigurationToDefault();
 
-bool setValueForCv(uint16_t cvIndex, uint8_t value);
-uint16_t getValueForCv(uint16_t cvIndex);
-
-uint8_t writeMaskForCv(uint16_t cvIndex);
-
 }
@@ -0,0 +1,198 @@
+#include "cvtable.h"
+
+#include "colors.h"
+#include "configuration.h"
+#include "dccdecode.h"
+#include "eepromlayout.h"
+#include "flash.h"
+#include "hal.h"
+#include <stddef.h>
+
+namespace cvtable {
+
+using config::Configuration;
+
+static_assert(sizeof(Configuration) <= 0xFF, "Configuration offsets must fit into a byte");
+static_assert(sizeof(colors::ColorRGB) * colors::COUNT <= 0xFF, "Color offsets must fit into a byte");
+static_assert(sizeof(dccdecode::Statistics) == 14, "Statistics must be packed, without padding");
+
+constexpr Descriptor configurationByte(uint16_t cv, uint8_t offset, uint8_t flags = 0, uint8_t writeMask = 0xFF, uint8_t min = 0, uint8_t max = 0xFF) {
+    return { cv, 1, uint8_t(STORAGE_CONFIGURATION | flags), offset, writeMask, min, max };
+}
+
+constexpr Descriptor constant(uint16_t cv, uint8_t value, uint8_t flags, uint8_t min = 0, uint8_t max = 0xFF) {
+    return { cv, 1, uint8_t(STORAGE_CONSTANT | flags), value, 0xFF, min, max };
+}
+
+// The address is stored little endian, as on both the AVR and the host
+const uint8_t ADDRESS_LOW = offsetof(Configuration, address);
+const uint8_t ADDRESS_HIGH = offsetof(Configuration, address) + 1;
+
+// Sorted by CV, for binary search
+constexpr Descriptor table[] PROGMEM = {
+    configurationByte(1, ADDRESS_LOW),
+    constant(7, 1, FLAG_READ_ONLY), // Decoder version number
+    // Manufacturer ID for home-made and public domain decoders; writing 8 resets everything
+    constant(8, 0x0D, FLAG_FACTORY_RESET, 8, 8),
+    configurationByte(9, ADDRESS_HIGH),
+    configurationByte(17, ADDRESS_HIGH),
+    configurationByte(18, ADDRESS_LOW),
+    // Pretend we can write it, but only to what it already was.
+    constant(29, config::DEFAULT_CONFIGURATION, 0, config::DEFAULT_CONFIGURATION, config::DEFAULT_CONFIGURATION),
+    // Extended area pointer; not really used at the moment
+    configurationByte(31, offsetof(Configuration, extendedRangeHigh)),
+    configurationByte(32, offsetof(Configuration, extendedRangeLow)),
+    configurationByte(config::CV_INDEX_BRIGHTNESS, offsetof(Configuration, brightness), FLAG_CHANGES_COLORS),
+    { config::CV_INDEX_COLOR_BASE, 3 * colors::COUNT, STORAGE_COLORS | FLAG_CHANGES_COLORS, 0, 0xFF, 0, 0xFF },
+    configurationByte(config::CV_INDEX_COLOR_ORDER, offsetof(Configuration, colorOrder), FLAG_CHANGES_COLORS),
+    configurationByte(config::CV_INDEX_NUM_SIGNAL_HEADS, offsetof(Configuration, activeSignalHeads), FLAG_CLAMP, 0xFF, 0, config::MAX_NUM_SIGNAL_HEADS),
+    configurationByte(config::CV_INDEX_WORKAROUNDS, offsetof(Configuration, workarounds), 0, config::WORKAROUND_VALID_BITS),
+    { config::CV_INDEX_ASPECT_BASE, config::ASPECT_COUNT, STORAGE_CONFIGURATION, offsetof(Configuration, aspects), config::ASPECT_VALID_BITS, 0, 0xFF },
+    { config::CV_INDEX_STATISTICS_BASE, sizeof(dccdecode::Statistics), STORAGE_STATISTICS, 0, 0xFF, 0, 0 },
+    { config::CV_INDEX_LED_MAPPING_BASE, config::MAX_NUM_LEDS, STORAGE_CONFIGURATION | FLAG_ALLOW_DARK, offsetof(Configuration, ledMapping), 0xFF, 0, config::MAX_NUM_SIGNAL_HEADS - 1 },
+};
+const uint8_t TABLE_LENGTH = sizeof(table) / sizeof(table[0]);
+
+constexpr bool isSortedWithoutOverlap() {
+    for (uint8_t i = 1; i < TABLE_LENGTH; i++) {
+        if (table[i - 1].cv + table[i - 1].count > table[i].cv) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(isSortedWithoutOverlap(), "CV table must be sorted and must not contain a CV twice");
+
+static bool find(uint16_t cv, Descriptor &descriptor) {
+    // Find the first entry after the CV; the one before is the only candidate
+    uint8_t low = 0;
+    uint8_t high = TABLE_LENGTH;
+    while (low < high) {
+        const uint8_t middle = (low + high) / 2;
+        if (flash::read(&table[middle].cv) <= cv) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == 0) {
+        return false;
+    }
+    descriptor = flash::read(&table[low - 1]);
+    return cv - descriptor.cv < descriptor.count;
+}
+
+static uint8_t *ramAddress(const Descriptor &descriptor, uint16_t cv) {
+    uint8_t *base = (descriptor.flags & FLAG_STORAGE_MASK) == STORAGE_COLORS ? (uint8_t *) colors::colorValues : (uint8_t *) &config::values;
+    return base + descriptor.offset + (cv - descriptor.cv);
+}
+
+static uint8_t *eepromAddress(const Descriptor &descriptor, uint16_t cv) {
+    uint8_t *base = (descriptor.flags & FLAG_STORAGE_MASK) == STORAGE_COLORS ? (uint8_t *) eepromlayout::stored.colors : (uint8_t *) &eepromlayout::stored.configuration;
+    return base + descriptor.offset + (cv - descriptor.cv);
+}
+
+uint16_t read(uint16_t cv) {
+    Descriptor descriptor;
+    if (!find(cv, descriptor)) {
+        return 0xFFFF;
+    }
+    switch (descriptor.flags & FLAG_STORAGE_MASK) {
+        case STORAGE_CONSTANT:
+            return descriptor.offset;
+        case STORAGE_STATISTICS: {
+            const dccdecode::Statistics statistics = dccdecode::getStatistics();
+            return ((const uint8_t *) &statistics)[descriptor.offset + (cv - descriptor.cv)];
+        }
+        default:
+            return *ramAddress(descriptor, cv);
+    }
+}
+
+// Finds the CV and brings the value into its range. Returns false if the write gets rejected.
+static bool prepareWrite(uint16_t cv, uint8_t &value, Descriptor &descriptor) {
+    if (!find(cv, descriptor) || (descriptor.flags & FLAG_READ_ONLY)) {
+        return false;
+    }
+
+    value &= descriptor.writeMask;
+    if (value < descriptor.min || value > descriptor.max) {
+        if ((descriptor.flags & FLAG_ALLOW_DARK) && value == config::LED_MAPPING_DARK) {
+            // Valid as well
+        } else if (descriptor.flags & FLAG_CLAMP) {
+            value = value < descriptor.min ? descriptor.min : descriptor.max;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static WriteResult result(const Descriptor &descriptor) {
+    if (descriptor.flags & FLAG_FACTORY_RESET) {
+        return WRITE_FACTORY_RESET;
+    }
+    if (descriptor.flags & FLAG_CHANGES_COLORS) {
+        return WRITE_CHANGES_COLORS;
+    }
+    return WRITE_DONE;
+}
+
+WriteResult write(uint16_t cv, uint8_t value) {
+    return writeBlock(cv, &value, 1);
+}
+
+WriteResult writeBlock(uint16_t firstCv, const uint8_t *values, uint8_t count) {
+    Descriptor descriptor;
+    uint8_t value;
+    for (uint8_t i = 0; i < count; i++) {
+        value = values[i];
+        if (!prepareWrite(firstCv + i, value, descriptor)) {
+            return WRITE_REJECTED;
+        }
+    }
+
+    WriteResult combined = WRITE_DONE;
+    // Consecutive CVs with the same descriptor are consecutive in RAM and EEPROM as well, so
+    // each run goes to the EEPROM as one block.
+    uint8_t runStart = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        value = values[i];
+        prepareWrite(firstCv + i, value, descriptor);
+        switch (descriptor.flags & FLAG_STORAGE_MASK) {
+            case STORAGE_CONSTANT:
+                break;
+            case STORAGE_STATISTICS:
+                dccdecode::resetStatistics();
+                break;
+            default:
+                *ramAddress(descriptor, firstCv + i) = value;
+                break;
+        }
+        const bool runEnds = i + 1 == count || uint16_t(firstCv + i + 1 - descriptor.cv) >= descriptor.count;
+        if (runEnds) {
+            const uint8_t storage = descriptor.flags & FLAG_STORAGE_MASK;
+            if (storage == STORAGE_CONFIGURATION || storage == STORAGE_COLORS) {
+                const uint16_t cv = firstCv + runStart;
+                hal::eepromUpdateBlock(ramAddress(descriptor, cv), eepromAddress(descriptor, cv), i + 1 - runStart);
+            }
+            runStart = i + 1;
+        }
+
+        const WriteResult written = result(descriptor);
+        if (written > combined) {
+            combined = written;
+        }
+    }
+    return combined;
+}
+
+uint8_t writeMask(uint16_t cv) {
+    Descriptor descriptor;
+    if (!find(cv, descriptor)) {
+        return 0xFF;
+    }
+    return descriptor.writeMask;
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+// All CVs of the decoder, as one sorted table in flash instead of a switch per operation.
+namespace cvtable {
+
+enum Storage: uint8_t {
+    // The value is in the descriptor; writes only check the range and have no effect.
+    STORAGE_CONSTANT = 0,
+    // Byte offset into config::values and the EEPROM
+    STORAGE_CONFIGURATION,
+    // Byte offset into colors::colorValues and the EEPROM
+    STORAGE_COLORS,
+    // Byte offset into dccdecode::getStatistics(), only in RAM. Writes reset the counters.
+    STORAGE_STATISTICS,
+};
+
+const uint8_t FLAG_STORAGE_MASK = 0x03;
+const uint8_t FLAG_READ_ONLY = (1 << 2);
+// Values outside [min, max] get clamped instead of rejected
+const uint8_t FLAG_CLAMP = (1 << 3);
+// config::LED_MAPPING_DARK is valid in addition to [min, max]
+const uint8_t FLAG_ALLOW_DARK = (1 << 4);
+// Needs colors::updateOutputColors() after a write
+const uint8_t FLAG_CHANGES_COLORS = (1 << 5);
+// Writing the (only valid) value resets the decoder to its defaults
+const uint8_t FLAG_FACTORY_RESET = (1 << 6);
+
+struct Descriptor {
+    uint16_t cv;
+    // Number of consecutive CVs, each one byte further into the storage
+    uint8_t count;
+    uint8_t flags;
+    // Offset into the storage, or the value for STORAGE_CONSTANT
+    uint8_t offset;
+    // Bits that can be changed; the others are always written as 0
+    uint8_t writeMask;
+    uint8_t min;
+    uint8_t max;
+};
+
+// Values <= 255 are actual values, anything else means "CV not supported"
+uint16_t read(uint16_t cv);
+
+// Sorted by how much the caller has to do afterwards
+enum WriteResult: uint8_t {
+    WRITE_REJECTED = 0,
+    WRITE_DONE,
+    WRITE_CHANGES_COLORS,
+    WRITE_FACTORY_RESET,
+};
+
+/*!
+ * Stores the value in RAM and EEPROM. Doesn't do anything for WRITE_FACTORY_RESET; the
+ * caller has to reset all modules, and to update everything that depends on the CVs.
+ */
+WriteResult write(uint16_t cv, uint8_t value);
+
+/*!
+ * Like write() for count consecutive CVs, e.g. from XPOM. Either all of them get written or,
+ * if any value gets rejected, none. CVs stored next to each other go to the EEPROM as one
+ * block. The result is the one that needs the most work from the caller.
+ */
+WriteResult writeBlock(uint16_t firstCv, const uint8_t *values, uint8_t count);
+
+// Bits of the CV that bit-wise writes may change
+uint8_t writeMask(uint16_t cv);
+
+}
@@ -0,0 +1,177 @@
+// Host only, see eepromimage.h
+#ifndef __AVR_ARCH__
+#include "eepromimage.h"
+
+#include "colors.h"
+#include "configuration.h"
+#include "eepromlayout.h"
+#include "hal.h"
+#include "main.h"
+
+#include <cstdlib>
+#include <sstream>
+
+namespace eepromimage {
+
+static std::string trim(const std::string &text) {
+    // Also the \r of Windows line ends
+    const size_t start = text.find_first_not_of(" \t\r");
+    const size_t end = text.find_last_not_of(" \t\r");
+    return start == std::string::npos ? "" : text.substr(start, end - start + 1);
+}
+
+static bool parseNumber(const std::string &text, long max, long &value) {
+    const std::string trimmed = trim(text);
+    char *end;
+    value = strtol(trimmed.c_str(), &end, 0);
+    return !trimmed.empty() && *end == '\0' && value >= 0 && value <= max;
+}
+
+static int colorIndex(const std::string &key) {
+    if (key == "red") return colors::RED;
+    if (key == "green") return colors::GREEN;
+    if (key == "yellow") return colors::YELLOW;
+    if (key == "lunar") return colors::LUNAR;
+    return -1;
+}
+
+// Returns an error message, or an empty string
+static std::string parseLine(const std::string &key, const std::string &value, std::vector<CvWrite> &writes) {
+    long number;
+    if (key == "address") {
+        if (!parseNumber(value, 2047, number) || number == 0) {
+            return "address must be 1 to 2047";
+        }
+        writes.push_back({ 1, uint8_t(number & 0xFF) });
+        writes.push_back({ 9, uint8_t(number >> 8) });
+    } else if (key == "brightness") {
+        if (!parseNumber(value, config::BRIGHTNESS_MAX, number)) {
+            return "brightness must be 0 to " + std::to_string(config::BRIGHTNESS_MAX);
+        }
+        writes.push_back({ config::CV_INDEX_BRIGHTNESS, uint8_t(number) });
+    } else if (key == "color_order") {
+        if (value == "rgb") {
+            writes.push_back({ config::CV_INDEX_COLOR_ORDER, config::Configuration::COLOR_ORDER_RGB });
+        } else if (value == "grb") {
+            writes.push_back({ config::CV_INDEX_COLOR_ORDER, config::Configuration::COLOR_ORDER_GRB });
+        } else {
+            return "color_order must be rgb or grb";
+        }
+    } else if (key == "heads") {
+        if (!parseNumber(value, config::MAX_NUM_SIGNAL_HEADS, number) || number == 0) {
+            return "heads must be 1 to " + std::to_string(config::MAX_NUM_SIGNAL_HEADS);
+        }
+        writes.push_back({ config::CV_INDEX_NUM_SIGNAL_HEADS, uint8_t(number) });
+    } else if (key == "workarounds") {
+        if (!parseNumber(value, config::WORKAROUND_VALID_BITS, number)) {
+            return "workarounds must be 0 to " + std::to_string(config::WORKAROUND_VALID_BITS);
+        }
+        writes.push_back({ config::CV_INDEX_WORKAROUNDS, uint8_t(number) });
+    } else if (colorIndex(key) >= 0) {
+        std::stringstream stream(value);
+        std::string component;
+        std::vector<uint8_t> components;
+        while (std::getline(stream, component, ',')) {
+            if (!parseNumber(component, 0xFF, number)) {
+                return key + " must be r, g, b with values 0 to 255";
+            }
+            components.push_back(uint8_t(number));
+        }
+        if (components.size() != 3) {
+            return key + " must be r, g, b with values 0 to 255";
+        }
+        for (uint8_t i = 0; i < 3; i++) {
+            writes.push_back({ uint16_t(config::CV_INDEX_COLOR_BASE + 3 * colorIndex(key) + i), components[i] });
+        }
+    } else if (key.compare(0, 2, "cv") == 0) {
+        long cv;
+        if (!parseNumber(key.substr(2), 1024, cv) || cv == 0) {
+            return "Unknown CV " + key;
+        }
+        if (!parseNumber(value, 0xFF, number)) {
+            return key + " must be 0 to 255";
+        }
+        writes.push_back({ uint16_t(cv), uint8_t(number) });
+    } else {
+        return "Unknown key " + key;
+    }
+    return "";
+}
+
+bool parseConfiguration(std::istream &input, std::vector<CvWrite> &writes, std::string &error) {
+    writes.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(input, line)) {
+        lineNumber++;
+        line = trim(line.substr(0, line.find_first_of("#;")));
+        if (line.empty()) {
+            continue;
+        }
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            error = "Line " + std::to_string(lineNumber) + ": Expected key = value";
+            return false;
+        }
+        const std::string lineError = parseLine(trim(line.substr(0, equals)), trim(line.substr(equals + 1)), writes);
+        if (!lineError.empty()) {
+            error = "Line " + std::to_string(lineNumber) + ": " + lineError;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool apply(const std::vector<CvWrite> &writes, std::string &error) {
+    // Factory reset
+    writeCvValue(8, 8);
+    for (const CvWrite &write : writes) {
+        if (write.cv == 8 || !writeCvValue(write.cv, write.value)) {
+            error = "CV" + std::to_string(write.cv) + " can't be set to " + std::to_string(write.value);
+            return false;
+        }
+        if (getCvValue(write.cv) != write.value) {
+            error = "CV" + std::to_string(write.cv) + " would be " + std::to_string(getCvValue(write.cv)) + " instead of " + std::to_string(write.value);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<uint8_t> image() {
+    // Reads include the writes still queued
+    std::vector<uint8_t> data(eepromlayout::SIZE);
+    hal::eepromReadBlock(data.data(), &eepromlayout::stored, eepromlayout::SIZE);
+    return data;
+}
+
+static void writeRecord(std::ostream &output, uint16_t address, uint8_t type, const uint8_t *data, uint8_t length) {
+    static const char digits[] = "0123456789ABCDEF";
+    const uint8_t header[] = { length, uint8_t(address >> 8), uint8_t(address & 0xFF), type };
+    uint8_t checksum = 0;
+    output << ':';
+    for (uint8_t byte : header) {
+        output << digits[byte >> 4] << digits[byte & 0x0F];
+        checksum += byte;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        output << digits[data[i] >> 4] << digits[data[i] & 0x0F];
+        checksum += data[i];
+    }
+    checksum = uint8_t(-checksum);
+    output << digits[checksum >> 4] << digits[checksum & 0x0F] << '\n';
+}
+
+void writeIntelHex(std::ostream &output, const std::vector<uint8_t> &data) {
+    const uint8_t RECORD_DATA = 0x00;
+    const uint8_t RECORD_END_OF_FILE = 0x01;
+    for (size_t address = 0; address < data.size(); address += 16) {
+        const uint8_t length = uint8_t(data.size() - address < 16 ? data.size() - address : 16);
+        writeRecord(output, uint16_t(address), RECORD_DATA, &data[address], length);
+    }
+    writeRecord(output, 0, RECORD_END_OF_FILE, nullptr, 0);
+}
+
+}
+
+#endif
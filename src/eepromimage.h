@@ -0,0 +1,48 @@
+#pragma once
+#ifndef __AVR_ARCH__
+
+#include <stdint.h>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Building EEPROM images on the host, for provisioning many decoders at once. A declarative
+// configuration becomes CV writes, which the firmware itself carries out on the simulated
+// hardware (hal_host.cpp); what ends up in the EEPROM gets written as Intel HEX, i.e. an .eep
+// file for avrdude. Used by tools/eepromimage and its tests.
+namespace eepromimage {
+
+struct CvWrite {
+    uint16_t cv;
+    uint8_t value;
+};
+
+/*!
+ * Reads lines of "key = value"; '#' and ';' start comments. Keys:
+ *   address = 1..2047          output address of the top signal head (CV1 and CV9)
+ *   brightness = 0..100        CV47
+ *   color_order = rgb | grb    CV64
+ *   heads = 1..MAX_NUM_SIGNAL_HEADS  CV65
+ *   workarounds = bits         CV66
+ *   red, green, yellow, lunar = r, g, b  the palette, CV48 and up
+ *   cv<N> = value              any other CV, e.g. cv31 and cv32, aspects or the LED mapping
+ * Numbers may be decimal or 0x hex. Later lines win.
+ */
+bool parseConfiguration(std::istream &input, std::vector<CvWrite> &writes, std::string &error);
+
+/*!
+ * Resets the simulated decoder to its defaults, then writes the CVs like programming on the
+ * track would. Fails for writes the decoder rejects or stores differently, e.g. clamped.
+ */
+bool apply(const std::vector<CvWrite> &writes, std::string &error);
+
+// The EEPROM contents after apply(), eepromlayout::SIZE bytes from address 0
+std::vector<uint8_t> image();
+
+// Intel HEX with 16 bytes per record, starting at address 0
+void writeIntelHex(std::ostream &output, const std::vector<uint8_t> &data);
+
+}
+
+#endif
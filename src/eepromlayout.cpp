@@ -0,0 +1,18 @@
+#include "eepromlayout.h"
+
+#include "hal.h"
+
+namespace eepromlayout {
+
+Layout stored EEMEM;
+
+bool hasCurrentVersion() {
+    return hal::eepromReadByte(&stored.version) == VERSION && hal::eepromReadByte(&stored.ledCount) == config::MAX_NUM_LEDS;
+}
+
+void storeCurrentVersion() {
+    hal::eepromUpdateByte(&stored.ledCount, config::MAX_NUM_LEDS);
+    hal::eepromUpdateByte(&stored.version, VERSION);
+}
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "colors.h"
+#include "configuration.h"
+
+// Everything the decoder keeps in the EEPROM, as its only EEMEM variable, so the linker puts
+// it at EEPROM address 0 and the layout doesn't depend on the link order. tools/eepromimage
+// builds .eep files with this layout to provision decoders with avrdude. The offsets below
+// get checked on the AVR and on the host alike; if an assert fails, images built before no
+// longer fit, so update the offsets deliberately, together with VERSION.
+namespace eepromlayout {
+
+struct Layout {
+    uint8_t ledCount;
+    uint8_t version;
+    config::Configuration configuration;
+    colors::ColorRGB colors[colors::COUNT];
+};
+
+extern Layout stored;
+
+// These two bytes come first, so that on startup a decoder notices an EEPROM that is blank
+// (0xFF) or was written with another layout, and falls back to the factory defaults instead
+// of reading other values into the wrong places. The layout depends on the build: everything
+// after the LED mapping moves with config::MAX_NUM_LEDS, so that is stored as well. Firmware
+// before this had the address here, with its high byte where VERSION is now; that is at most
+// 7 for the 2047 output addresses.
+const uint8_t VERSION = 0xA1;
+
+const uint16_t OFFSET_LED_COUNT = 0;
+const uint16_t OFFSET_VERSION = 1;
+const uint16_t OFFSET_ADDRESS = 2;
+const uint16_t OFFSET_BRIGHTNESS = 4;
+const uint16_t OFFSET_COLOR_ORDER = 5;
+const uint16_t OFFSET_ACTIVE_SIGNAL_HEADS = 6;
+const uint16_t OFFSET_WORKAROUNDS = 7;
+const uint16_t OFFSET_LED_MAPPING = 8;
+// CV31 and 32
+const uint16_t OFFSET_EXTENDED_RANGE_HIGH = OFFSET_LED_MAPPING + config::MAX_NUM_LEDS;
+const uint16_t OFFSET_EXTENDED_RANGE_LOW = OFFSET_EXTENDED_RANGE_HIGH + 1;
+const uint16_t OFFSET_ASPECTS = OFFSET_EXTENDED_RANGE_LOW + 1;
+// r, g and b for each colors::ColorName
+const uint16_t OFFSET_COLORS = OFFSET_ASPECTS + config::ASPECT_COUNT;
+const uint16_t SIZE = OFFSET_COLORS + 3 * colors::COUNT;
+
+// ATtiny85
+const uint16_t EEPROM_SIZE = 512;
+
+static_assert(offsetof(Layout, ledCount) == OFFSET_LED_COUNT, "EEPROM layout changed");
+static_assert(offsetof(Layout, version) == OFFSET_VERSION, "EEPROM layout changed");
+static_assert(offsetof(Layout, configuration.address) == OFFSET_ADDRESS, "EEPROM layout changed");
+static_assert(offsetof(Layout, configuration.brightness) == OFFSET_BRIGHTNESS, "EEPROM layout changed");
+static_assert(offsetof(Layout, configuration.colorOrder) == OFFSET_COLOR_ORDER, "EEPROM layout changed");
+static_assert(offsetof(Layout, configuration.activeSignalHeads) == OFFSET_ACTIVE_SIGNAL_HEADS, "EEPROM layout changed");
+static_assert(offsetof(Layout, configuration.workarounds) == OFFSET_WORKAROUNDS, "EEPROM layout changed");
+static_assert(offsetof(Layout, configuration.ledMapping) == OFFSET_LED_MAPPING, "EEPROM layout changed");
+static_assert(offsetof(Layout, configuration.extendedRangeHigh) == OFFSET_EXTENDED_RANGE_HIGH, "EEPROM layout changed");
+static_assert(offsetof(Layout, configuration.extendedRangeLow) == OFFSET_EXTENDED_RANGE_LOW, "EEPROM layout changed");
+static_assert(offsetof(Layout, configuration.aspects) == OFFSET_ASPECTS, "EEPROM layout changed");
+static_assert(offsetof(Layout, colors) == OFFSET_COLORS, "EEPROM layout changed");
+// Also catches padding, which the host would add where the AVR doesn't
+static_assert(sizeof(Layout) == SIZE, "EEPROM layout changed");
+static_assert(SIZE <= EEPROM_SIZE, "EEPROM layout doesn't fit into the EEPROM");
+
+// Same VERSION and config::MAX_NUM_LEDS
+bool hasCurrentVersion();
+// After a factory reset, which writes everything else
+void storeCurrentVersion();
+
+}
@@ -0,0 +1,63 @@
+#include "eepromqueue.h"
+
+namespace eepromqueue {
+
+// Ring buffer with free running indices; the interrupt only ever moves readIndex
+Write writes[LENGTH];
+volatile uint8_t readIndex = 0;
+volatile uint8_t writeIndex = 0;
+
+bool push(uint8_t *address, uint8_t value) {
+    for (uint8_t i = readIndex; i != writeIndex; i++) {
+        if (writes[i & (LENGTH - 1)].address == address) {
+            writes[i & (LENGTH - 1)].value = value;
+            return true;
+        }
+    }
+    if (isFull()) {
+        return false;
+    }
+    writes[writeIndex & (LENGTH - 1)] = { address, value };
+    // Only now can pop() see it
+    writeIndex = writeIndex + 1;
+    return true;
+}
+
+bool pop(Write &write) {
+    if (readIndex == writeIndex) {
+        return false;
+    }
+    write = writes[readIndex & (LENGTH - 1)];
+    readIndex = readIndex + 1;
+    return true;
+}
+
+bool isEmpty() {
+    return readIndex == writeIndex;
+}
+
+bool isFull() {
+    return uint8_t(writeIndex - readIndex) >= LENGTH;
+}
+
+bool find(const uint8_t *address, uint8_t &value) {
+    for (uint8_t i = readIndex; i != writeIndex; i++) {
+        if (writes[i & (LENGTH - 1)].address == address) {
+            value = writes[i & (LENGTH - 1)].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+void overlay(void *destination, const void *source, size_t size) {
+    const uint8_t *start = (const uint8_t *) source;
+    for (uint8_t i = readIndex; i != writeIndex; i++) {
+        const Write &write = writes[i & (LENGTH - 1)];
+        if (write.address >= start && write.address < start + size) {
+            ((uint8_t *) destination)[write.address - start] = write.value;
+        }
+    }
+}
+
+}
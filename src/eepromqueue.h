@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Writes waiting for the EEPROM, which takes about 3.4 ms per byte. The HAL fills this from
+// the main loop and drains it one byte at a time, on the ATtiny85 from the EE_READY
+// interrupt. Reads have to check here first, since the EEPROM may not have the latest value
+// yet.
+//
+// Nothing here turns interrupts off. Only pop() may run in the interrupt; while the main loop
+// calls anything else, the HAL keeps the EE_READY interrupt from running, so the DCC
+// interrupts don't have to wait for the search through the queue.
+
+// Number of pending writes, must be a power of two. Enough for a CV write or an XPOM packet
+// without waiting; a factory reset waits until the first few writes are done.
+#ifndef EEPROMQUEUE_LENGTH
+#define EEPROMQUEUE_LENGTH 16
+#endif
+
+namespace eepromqueue {
+
+const uint8_t LENGTH = EEPROMQUEUE_LENGTH;
+static_assert(LENGTH > 0 && LENGTH <= 128 && (LENGTH & (LENGTH - 1)) == 0, "EEPROM queue length must be a power of two up to 128");
+
+struct Write {
+    uint8_t *address;
+    uint8_t value;
+};
+
+// Queues a write, or changes the value of a write to the same address that is still waiting.
+// Returns false if the queue is full.
+bool push(uint8_t *address, uint8_t value);
+// Takes the oldest write out of the queue, returns false if there is none
+bool pop(Write &write);
+bool isEmpty();
+bool isFull();
+
+// Gets the value waiting to be written to the address, returns false if there is none
+bool find(const uint8_t *address, uint8_t &value);
+// Replaces what was read from the EEPROM at source with the values still waiting to be
+// written there
+void overlay(void *destination, const void *source, size_t size);
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// Constant data that stays in flash. The AVR needs special instructions to read it;
+// everywhere else it is ordinary memory.
+
+#include <stdint.h>
+
+#ifdef __AVR_ARCH__
+#include <avr/pgmspace.h>
+#else
+#include <string.h>
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *) (address))
+#define memcpy_P memcpy
+#endif
+
+namespace flash {
+
+// Copies a whole object declared PROGMEM into RAM
+template<typename T>
+T read(const T *address) {
+    T value;
+    memcpy_P(&value, address, sizeof(T));
+    return value;
+}
+
+}
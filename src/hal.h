@@ -0,0 +1,93 @@
+#pragma once
+
+// Everything the firmware needs from the hardware. hal_avr.cpp implements it for the
+// ATtiny85, hal_host.cpp simulates it, so the whole firmware can run in native tests and
+// benchmarks.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __AVR_ARCH__
+#include <avr/eeprom.h>
+#else
+// The EEPROM is ordinary RAM on the host
+#define EEMEM
+#endif
+
+namespace hal {
+
+// Called once during setup, before interrupts are enabled
+void setupDccInput();
+void setupAckPin();
+void enableInterrupts();
+
+// Waits until the next interrupt
+void sleep();
+
+// Timer1 calls onTimer1() either every 20 ms for the animations, or once after 6 ms to end
+// an ACK pulse, until stopped.
+void startAnimationTimer();
+void startAckTimer();
+void stopTimer1();
+// Implemented by the firmware, called from the timer interrupt
+void onTimer1();
+
+// Turns the current for the programming ACK on or off
+void setAckPin(bool on);
+
+// Sends length bytes to the WS2812 chain, three per LED. With LEDOUTPUT_CHUNKED, this only
+// starts sending between the DCC bits (see ledoutput.h) and replaces a frame that isn't done
+// yet. So while ledsBusy() returns true, the data may only change for a new frame at least
+// as long as the last one.
+void sendLeds(const uint8_t *data, uint16_t length);
+bool ledsBusy();
+// Sends what is left of the last frame at once, if anything
+void finishLeds();
+
+// EEPROM access, for variables declared EEMEM. Updates only queue the write (see
+// eepromqueue.h) unless the queue is full; reads already return the queued values.
+uint8_t eepromReadByte(const uint8_t *address);
+void eepromReadBlock(void *destination, const void *source, size_t size);
+void eepromUpdateByte(uint8_t *address, uint8_t value);
+void eepromUpdateWord(uint16_t *address, uint16_t value);
+void eepromUpdateBlock(const void *source, void *destination, size_t size);
+// Whether some updates have not reached the EEPROM yet
+bool eepromWritesPending();
+
+#ifndef __AVR_ARCH__
+// What the simulated hardware did, for tests and benchmarks
+namespace host {
+    const uint16_t MAX_LED_BYTES = 255;
+
+    struct State {
+        bool timer1Running = false;
+        bool ackTimer = false;
+        bool ackPinOn = false;
+        uint32_t acks = 0;
+
+        // What the LEDs show; sendLeds() only changes the start
+        uint8_t leds[MAX_LED_BYTES] = {};
+        uint32_t ledTransmissions = 0;
+        uint32_t ledBytesSent = 0;
+
+        // Bytes that actually changed in the EEPROM
+        uint32_t eepromBytesWritten = 0;
+        // How long the firmware had to wait for the EEPROM, and how long it would have without
+        // the queue
+        uint32_t eepromBlockedMicroseconds = 0;
+        uint32_t eepromSynchronousMicroseconds = 0;
+        // Progress of the current EEPROM write
+        uint32_t eepromWriteMicroseconds = 0;
+    };
+    extern State state;
+
+    const uint32_t EEPROM_WRITE_MICROSECONDS = 3400;
+
+    // Calls onTimer1() if the timer is running, returns whether it did
+    bool fireTimer1();
+    // Lets time pass for the EEPROM, which finishes queued writes
+    void advanceTime(uint32_t microseconds);
+}
+#endif
+
+}
@@ -0,0 +1,222 @@
+// The HAL for the ATtiny85, see hal.h
+#ifdef __AVR_ARCH__
+#include "hal.h"
+#include "eepromqueue.h"
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include <dccdecode.h>
+
+// Skip the reset; we pinky promise not to send updates too often.
+#define ws2812_resettime 0
+#include <light_ws2812.h>
+#include <light_ws2812.c>
+
+#ifdef LEDOUTPUT_CHUNKED
+#ifndef DCCDECODE_SAMPLE_HOOK
+#error "LEDOUTPUT_CHUNKED needs DCCDECODE_SAMPLE_HOOK"
+#endif
+#include "configuration.h"
+#include "ledoutput.h"
+#include <util/atomic.h>
+#include <util/delay.h>
+
+static_assert(config::MAX_NUM_LEDS * 3 <= ledoutput::BYTES_PER_PACKET, "Too many LEDs to send between DCC bits");
+#endif
+
+/*
+ * PB2: DCC Input
+ * PB3: LEDs
+ * PB4: ACK
+ * Timer 0: Handles DCC
+ * Timer 1: Handles animation in normal mode, ack pulse in programming (same settings)
+ */
+
+// Which pin on the controller is connected to the NeoPixels?
+#define PIN_LED        _BV(PB3)
+
+// The pin to use for acknowledgements
+#define ACK_PIN_MASK  _BV(PB4)
+
+// WAIT_TIME_ACK: (8 Mhz / 1024) * 6 ms
+// 1024 is from prescaler
+#define WAIT_TIME_ACK 47
+
+namespace hal {
+
+void setupDccInput() {
+  // Timer 0: Measures DCC signal
+  dccdecode::setupTimer0();
+
+  // DCC Input
+  dccdecode::setupInt0PB2();
+}
+
+void setupAckPin() {
+  DDRB |= ACK_PIN_MASK;
+  PORTB &= ~ACK_PIN_MASK;
+}
+
+void enableInterrupts() {
+  sei();
+}
+
+void sleep() {
+  MCUCR |= (1 << SE); // Sleep enable, sleep mode 000 = Idle
+  sleep_cpu();
+}
+
+void startAnimationTimer() {
+  // Run roughly every twenty milliseconds
+  OCR1A = 156;
+  TCNT1 = 0;
+  TCCR1 = (1 << CS13) | (1 << CS11) | (1 << CS10); // Normal mode, clear on OCR1A match, run immediately with CLK/1024
+  TIMSK |= (1 << OCIE1A); // Interrupts on
+}
+
+void startAckTimer() {
+  // Turn off increased power after 5-7 ms
+  OCR1A = WAIT_TIME_ACK;
+  TCNT1 = 0;
+  TCCR1 = (1 << CTC1) | (1 << CS13) | (1 << CS11) | (1 << CS10); // Normal mode, clear on OCR1A match, run immediately with CLK/1024
+  TIMSK |= (1 << OCIE1A); // Interrupts on
+}
+
+void stopTimer1() {
+  TCCR1 = 0;
+}
+
+void setAckPin(bool on) {
+  if (on) {
+    PORTB |= ACK_PIN_MASK;
+  } else {
+    PORTB &= ~ACK_PIN_MASK;
+  }
+}
+
+#ifdef LEDOUTPUT_CHUNKED
+void sendLeds(const uint8_t *data, uint16_t length) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    ledoutput::start(data, length);
+  }
+}
+
+bool ledsBusy() {
+  return ledoutput::isBusy();
+}
+
+void finishLeds() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    ledoutput::Chunk rest = ledoutput::takeRest();
+    if (rest.length > 0) {
+      _delay_us(ledoutput::LATCH_MICROSECONDS);
+      ws2812_sendarray_mask((uint8_t *) rest.data, rest.length, PIN_LED);
+    }
+  }
+}
+#else
+void sendLeds(const uint8_t *data, uint16_t length) {
+  ws2812_sendarray_mask((uint8_t *) data, length, PIN_LED);
+}
+
+bool ledsBusy() {
+  return false;
+}
+
+void finishLeds() {
+}
+#endif
+
+// The EE_READY interrupt takes writes out of the queue. Everything else that touches the
+// queue keeps it from doing that, instead of turning off all interrupts while it searches
+// the queue: the DCC interrupts must not be late. For reading, this also makes sure a value
+// is either in the queue or in what got read. A write that already started is fine, since
+// reading waits for it to finish.
+static void pauseEepromWrites() {
+  EECR &= ~(1 << EERIE);
+}
+
+static void resumeEepromWrites() {
+  if (!eepromqueue::isEmpty()) {
+    EECR |= (1 << EERIE);
+  }
+}
+
+uint8_t eepromReadByte(const uint8_t *address) {
+  pauseEepromWrites();
+  uint8_t value;
+  if (!eepromqueue::find(address, value)) {
+    value = eeprom_read_byte(address);
+  }
+  resumeEepromWrites();
+  return value;
+}
+
+void eepromReadBlock(void *destination, const void *source, size_t size) {
+  pauseEepromWrites();
+  eeprom_read_block(destination, source, size);
+  eepromqueue::overlay(destination, source, size);
+  resumeEepromWrites();
+}
+
+void eepromUpdateByte(uint8_t *address, uint8_t value) {
+  if (eepromReadByte(address) == value) {
+    return;
+  }
+  pauseEepromWrites();
+  while (!eepromqueue::push(address, value)) {
+    // Full; the interrupt makes room, one byte at a time
+    EECR |= (1 << EERIE);
+    while (eepromqueue::isFull()) {}
+    pauseEepromWrites();
+  }
+  EECR |= (1 << EERIE);
+}
+
+void eepromUpdateWord(uint16_t *address, uint16_t value) {
+  eepromUpdateBlock(&value, address, sizeof(value));
+}
+
+void eepromUpdateBlock(const void *source, void *destination, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    eepromUpdateByte(&((uint8_t *) destination)[i], ((const uint8_t *) source)[i]);
+  }
+}
+
+bool eepromWritesPending() {
+  return !eepromqueue::isEmpty() || (EECR & (1 << EEPE));
+}
+
+}
+
+// The EEPROM is ready for the next byte
+ISR(EE_RDY_vect) {
+  eepromqueue::Write write;
+  if (!eepromqueue::pop(write)) {
+    EECR &= ~(1 << EERIE);
+    return;
+  }
+  EEAR = uint16_t(uintptr_t(write.address));
+  EEDR = write.value;
+  // Erase and write in one operation
+  EECR = (1 << EERIE) | (1 << EEMPE);
+  EECR |= (1 << EEPE);
+}
+
+#ifdef LEDOUTPUT_CHUNKED
+// Called from the Timer0 interrupt; the next DCC edge is far enough away for the chunk.
+void dccdecode::afterSample(bool bitValue, bool packetEnded) {
+  ledoutput::Chunk chunk = ledoutput::afterSample(bitValue, packetEnded);
+  if (chunk.length > 0) {
+    ws2812_sendarray_mask((uint8_t *) chunk.data, chunk.length, PIN_LED);
+  }
+}
+#endif
+
+// Timer1 has fired.
+ISR(TIMER1_COMPA_vect) {
+  TCNT1 = 0;
+  hal::onTimer1();
+}
+#endif
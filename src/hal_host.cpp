@@ -0,0 +1,143 @@
+// Simulated hardware for the native platform, see hal.h
+#ifndef __AVR_ARCH__
+#include "hal.h"
+#include "eepromqueue.h"
+
+#include <string.h>
+
+namespace hal {
+
+namespace host {
+    State state;
+
+    bool fireTimer1() {
+        if (!state.timer1Running) {
+            return false;
+        }
+        // The ACK timer runs once in CTC mode but stopping it is up to the handler, as on the
+        // device.
+        onTimer1();
+        return true;
+    }
+}
+
+using host::state;
+
+void setupDccInput() {
+    // Tests feed bits to dccdecode directly
+}
+
+void setupAckPin() {
+    state.ackPinOn = false;
+}
+
+void enableInterrupts() {
+}
+
+void sleep() {
+}
+
+void startAnimationTimer() {
+    state.timer1Running = true;
+    state.ackTimer = false;
+}
+
+void startAckTimer() {
+    state.timer1Running = true;
+    state.ackTimer = true;
+}
+
+void stopTimer1() {
+    state.timer1Running = false;
+}
+
+void setAckPin(bool on) {
+    if (on && !state.ackPinOn) {
+        state.acks++;
+    }
+    state.ackPinOn = on;
+}
+
+void sendLeds(const uint8_t *data, uint16_t length) {
+    if (length > host::MAX_LED_BYTES) {
+        length = host::MAX_LED_BYTES;
+    }
+    memcpy(state.leds, data, length);
+    state.ledTransmissions++;
+    state.ledBytesSent += length;
+}
+
+bool ledsBusy() {
+    return false;
+}
+
+void finishLeds() {
+}
+
+uint8_t eepromReadByte(const uint8_t *address) {
+    uint8_t value;
+    if (eepromqueue::find(address, value)) {
+        return value;
+    }
+    return *address;
+}
+
+void eepromReadBlock(void *destination, const void *source, size_t size) {
+    memcpy(destination, source, size);
+    eepromqueue::overlay(destination, source, size);
+}
+
+static bool writeNext() {
+    eepromqueue::Write write;
+    if (!eepromqueue::pop(write)) {
+        return false;
+    }
+    *write.address = write.value;
+    state.eepromBytesWritten++;
+    return true;
+}
+
+void eepromUpdateByte(uint8_t *address, uint8_t value) {
+    if (eepromReadByte(address) == value) {
+        return;
+    }
+    state.eepromSynchronousMicroseconds += host::EEPROM_WRITE_MICROSECONDS;
+    while (!eepromqueue::push(address, value)) {
+        // Wait for the current write to finish
+        state.eepromBlockedMicroseconds += host::EEPROM_WRITE_MICROSECONDS - state.eepromWriteMicroseconds;
+        state.eepromWriteMicroseconds = 0;
+        writeNext();
+    }
+}
+
+void eepromUpdateWord(uint16_t *address, uint16_t value) {
+    eepromUpdateBlock(&value, address, sizeof(value));
+}
+
+void eepromUpdateBlock(const void *source, void *destination, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        eepromUpdateByte(&((uint8_t *) destination)[i], ((const uint8_t *) source)[i]);
+    }
+}
+
+bool eepromWritesPending() {
+    return !eepromqueue::isEmpty();
+}
+
+namespace host {
+    void advanceTime(uint32_t microseconds) {
+        if (eepromqueue::isEmpty()) {
+            return;
+        }
+        state.eepromWriteMicroseconds += microseconds;
+        while (state.eepromWriteMicroseconds >= EEPROM_WRITE_MICROSECONDS && writeNext()) {
+            state.eepromWriteMicroseconds -= EEPROM_WRITE_MICROSECONDS;
+        }
+        if (eepromqueue::isEmpty()) {
+            state.eepromWriteMicroseconds = 0;
+        }
+    }
+}
+
+}
+#endif
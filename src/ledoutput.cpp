@@ -0,0 +1,56 @@
+#include "ledoutput.h"
+
+namespace ledoutput {
+
+// The frame and how far it got; frameLength == sent when done
+const uint8_t *volatile frame = nullptr;
+volatile uint8_t frameLength = 0;
+volatile uint8_t sent = 0;
+// Samples since the last chunk, up to LATCH_SAMPLES
+volatile uint8_t quietSamples = LATCH_SAMPLES;
+
+void start(const uint8_t *data, uint8_t length) {
+    frame = data;
+    frameLength = length;
+    sent = 0;
+}
+
+bool isBusy() {
+    return sent != frameLength;
+}
+
+Chunk afterSample(bool bitValue, bool packetEnded) {
+    Chunk chunk = { frame + sent, 0 };
+    if (packetEnded) {
+        // The next sample may be the start of a RailCom cutout, so nothing goes out until the
+        // one after that. The LEDs may latch in between, and the frame starts over.
+        if (isBusy()) {
+            sent = 0;
+        }
+        quietSamples = 0;
+    } else if (isBusy() && (sent != 0 || quietSamples >= LATCH_SAMPLES)) {
+        const uint8_t fits = bitValue ? BYTES_AFTER_ONE : BYTES_AFTER_ZERO;
+        const uint8_t left = frameLength - sent;
+        chunk.length = left < fits ? left : fits;
+        sent = sent + chunk.length;
+    }
+
+    if (chunk.length > 0) {
+        quietSamples = 0;
+    } else if (quietSamples < LATCH_SAMPLES) {
+        quietSamples = quietSamples + 1;
+    }
+    return chunk;
+}
+
+Chunk takeRest() {
+    Chunk chunk = { frame, 0 };
+    if (isBusy()) {
+        chunk.length = frameLength;
+        sent = frameLength;
+        quietSamples = 0;
+    }
+    return chunk;
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include "dccdecode.h"
+
+// Sending a frame to the WS2812 chain in chunks between the bits of the DCC signal, for
+// LEDOUTPUT_CHUNKED. Sending one byte takes 10 µs with interrupts off, so a whole frame sent
+// at once delays the next DCC edge and corrupts that bit. Instead, the HAL starts a frame
+// here, and dccdecode::afterSample() sends the part that fits before the next falling edge
+// can come in. That's the only thing the firmware does at that point, so it never misses one.
+//
+// The WS2812 keep what they got as long as the data line isn't low for longer than their
+// reset time; then they latch and the next byte goes to the first LED again. This needs LEDs
+// that only latch after 280 µs (WS2812B-V5, WS2813, WS2815), and a command station that
+// doesn't stretch zeros. RailCom cutouts are fine: the frame starts over after each packet.
+
+namespace ledoutput {
+
+// Sending one byte at 800 kHz
+const uint8_t MICROSECONDS_PER_BYTE = 10;
+// From the falling edge to the first LED bit after the sample: the INT0 and Timer0
+// interrupts and receivedBit() at 8 MHz, with some margin
+const uint8_t SAMPLE_OVERHEAD = 15;
+
+// What fits in after sampling a 1 and a 0
+const uint8_t BYTES_AFTER_ONE = (2 * dccdecode::DCC_HALF_BIT_ONE_MIN - dccdecode::DCC_WAIT_TIME - SAMPLE_OVERHEAD) / MICROSECONDS_PER_BYTE;
+const uint8_t BYTES_AFTER_ZERO = (2 * dccdecode::DCC_HALF_BIT_ZERO_MIN - dccdecode::DCC_WAIT_TIME - SAMPLE_OVERHEAD) / MICROSECONDS_PER_BYTE;
+static_assert(BYTES_AFTER_ONE >= 1, "Not even one LED byte fits in after a 1");
+
+// Low time after which the LEDs latch for sure
+const uint16_t LATCH_MICROSECONDS = 280;
+// Longest half-bit of a 0 without zero stretching
+const uint8_t LONGEST_ZERO_HALF_BIT = 120;
+static_assert(2 * LONGEST_ZERO_HALF_BIT + SAMPLE_OVERHEAD < LATCH_MICROSECONDS, "The LEDs would latch between two DCC bits");
+
+// Samples without sending anything after which the LEDs have latched for sure. A frame only
+// starts after that, so a new frame can replace one that isn't done yet. The count starts
+// again at the end of each packet, where a RailCom cutout may follow, and an unfinished frame
+// starts over.
+const uint8_t LATCH_SAMPLES = 2;
+static_assert(LATCH_SAMPLES * 2 * dccdecode::DCC_HALF_BIT_ONE_MIN + dccdecode::DCC_WAIT_TIME >= LATCH_MICROSECONDS, "The LEDs may not have latched yet");
+
+// Frame length that gets sent completely between two packet ends, whatever the packets are.
+// After the cutout there are at least 10 preamble bits. The shortest packet has three bytes
+// with the XOR byte, so each bit position has a 0 in at least one of them, and the start bit
+// and two separators are 0 as well.
+const uint16_t BYTES_PER_PACKET = (10 - (LATCH_SAMPLES - 1) + 16) * BYTES_AFTER_ONE + (8 + 3) * BYTES_AFTER_ZERO;
+
+struct Chunk {
+    const uint8_t *data;
+    uint8_t length;
+};
+
+// Starts sending length bytes from data, dropping any frame that isn't done yet. The data
+// must not change until isBusy() returns false.
+void start(const uint8_t *data, uint8_t length);
+bool isBusy();
+
+// Called right after each DCC sample, with interrupts off: what to send now, if anything
+Chunk afterSample(bool bitValue, bool packetEnded);
+
+// The whole frame again if it isn't done yet, to send at once when there is no DCC signal to
+// send it with. The caller has to wait LATCH_MICROSECONDS before sending it, with interrupts
+// off until it is done.
+Chunk takeRest();
+
+}
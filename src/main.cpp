@@ -1,30 +1,13 @@
-#include <avr/interrupt.h>
-#include <avr/sleep.h>
-#include <avr/eeprom.h>
-#include <string.h> // For memset
-
 #include "dccdecode.h"
-#include "signalhead.h"
+#include "signalbank.h"
 #include "configuration.h"
+#include "cvtable.h"
+#include "eepromlayout.h"
+#include "packetcache.h"
+#include "hal.h"
+#include "main.h"
 
-// Skip the reset; we pinky promise not to send updates too often.
-#define ws2812_resettime 0
-#include <light_ws2812.h>
-#include <light_ws2812.c>
-
-// Which pin on the controller is connected to the NeoPixels?
-#define PIN_LED        _BV(PB3)
-
-/*
- * PB2: DCC Input
- * PB3: LEDs
- * PB4: ACK
- * Timer 0: Handles DCC
- * Timer 1: Handles animation in normal mode, ack pulse in programming (same settings)
- */
-
-// The pin to use for acknowledgements
-#define ACK_PIN_MASK  _BV(PB4)
+// Pins and timers are in hal_avr.cpp
 
 enum DecoderMode: uint8_t {
   DECODER_MODE_OPERATION = 0,
@@ -35,33 +18,31 @@ enum DecoderMode: uint8_t {
 };
 volatile DecoderMode decoderMode = DECODER_MODE_OPERATION;
 
-// WAIT_TIME_ACK: (8 Mhz / 1024) * 6 ms
-// 1024 is from prescaler
-#define WAIT_TIME_ACK 47
-
 volatile uint8_t animationTimestep = 0;
 
-// Color values
-const uint8_t CV_INDEX_COLOR_BASE = 48;
-const uint8_t CV_INDEX_COLOR_LENGTH = 3 * colors::COUNT;
+SignalBank<config::MAX_NUM_SIGNAL_HEADS, config::LEDS_PER_HEAD> signalBank(config::values.ledMapping);
+#ifdef __AVR_ARCH__
+// Leaves the rest of the 512 bytes to the DCC message queue, colors, configuration and stack
+static_assert(sizeof(signalBank) <= 256, "Signal bank does not fit into RAM, use fewer heads or LEDs per head");
+#endif
 
-SignalHead signalHeads[config::MAX_NUM_SIGNAL_HEADS];
-uint8_t signalHeadColors[3*config::MAX_NUM_SIGNAL_HEADS];
+uint16_t activeLedBytes() {
+  return uint16_t(config::values.activeSignalHeads) * config::LEDS_PER_HEAD * 3;
+}
 
 void turnLedsOff() {
-    memset(signalHeadColors, 0, sizeof(signalHeadColors));
-    ws2812_sendarray_mask(signalHeadColors, config::values.activeSignalHeads*3, PIN_LED);
+    signalBank.fill(0);
+    hal::sendLeds(signalBank.leds, activeLedBytes());
 }
 
 // Timer1 has fired.
-ISR(TIMER1_COMPA_vect) {
-  TCNT1 = 0;
+void hal::onTimer1() {
   if (decoderMode == DECODER_MODE_SENDING_ACK) {
-    TCCR1 = 0; // Stop timer
+    hal::stopTimer1();
 #ifdef ACK_VIA_LEDS
     turnLedsOff();
 #else
-    PORTB &= ~ACK_PIN_MASK;
+    hal::setAckPin(false);
 #endif
     decoderMode = DECODER_MODE_PROGRAMMING;
   } else if (decoderMode == DECODER_MODE_OPERATION) {
@@ -70,61 +51,89 @@ ISR(TIMER1_COMPA_vect) {
   }
 }
 
+// The packet filter lets through only what parseNewMessage() can act on in normal operation,
+// so it is off while programming.
+void updatePacketFilter() {
+  if (decoderMode == DECODER_MODE_OPERATION || decoderMode == DECODER_MODE_EMERGENCY_STOP) {
+    dccdecode::setPacketFilter(config::values.address, config::values.activeSignalHeads * 3);
+  } else {
+    dccdecode::disablePacketFilter();
+  }
+}
+
+// Makes the LEDs show the new colors after colors::outputColorValues or the LED mapping
+// changed, since the animation timer may be stopped. While programming, Timer1 is busy with
+// the ACK and the LEDs are off; going back to normal operation redraws them anyway.
+void redrawLeds() {
+  signalBank.redraw();
+  if (decoderMode == DECODER_MODE_OPERATION) {
+    SignalHead::startAnimationTimer();
+  }
+}
+
+// Total reset of everything
+void factoryReset() {
+  colors::restoreDefaultColorsToEeprom();
+  config::resetConfigurationToDefault();
+  colors::updateOutputColors();
+  eepromlayout::storeCurrentVersion();
+}
+
 void setup() {
   turnLedsOff();
 
   // Load address from EEPROM
   config::loadConfiguration();
   colors::loadColorsFromEeprom();
+  updatePacketFilter();
 
-  // Timer 0: Measures DCC signal
-  dccdecode::setupTimer0();
-
-  // DCC Input
-  dccdecode::setupInt0PB2();
+  // Timer 0 and the input pin
+  hal::setupDccInput();
 
 #ifndef ACK_VIA_LEDS
-  DDRB |= ACK_PIN_MASK;
-  PORTB &= ~ACK_PIN_MASK;
+  hal::setupAckPin();
 #endif
 
   // Prepare timer 1 for animation purposes
   SignalHead::setupTimer1();
-  sei();
+  hal::enableInterrupts();
+
+  // Blank or from older firmware. Only now, since a factory reset has to wait for the EEPROM
+  // interrupt.
+  if (!eepromlayout::hasCurrentVersion()) {
+    factoryReset();
+    updatePacketFilter();
+  }
 }
 
 // Values <= 255 are actual values, anything else means "CV not supported"
 uint16_t getCvValue(uint16_t cvIndex) {
-  if (cvIndex >= CV_INDEX_COLOR_BASE && cvIndex < CV_INDEX_COLOR_BASE + CV_INDEX_COLOR_LENGTH) {
-    return colors::getColorValue(cvIndex - CV_INDEX_COLOR_BASE);
-  }
-
-  switch (cvIndex) {
-    case 7: return 1; // Decoder version number
-    case 8: return 0x0D; // Manufacturer ID for home-made and public domain decoders
-    default: return config::getValueForCv(cvIndex);
-  }
+  return cvtable::read(cvIndex);
 }
 
 bool writeCvValue(uint16_t cvIndex, uint8_t newValue) {
-  if (cvIndex >= CV_INDEX_COLOR_BASE && cvIndex < CV_INDEX_COLOR_BASE + CV_INDEX_COLOR_LENGTH) {
-    colors::writeColorValueToEeprom(cvIndex - CV_INDEX_COLOR_BASE, newValue);
-    return true;
-  }
+  return writeCvValues(cvIndex, &newValue, 1);
+}
 
-  switch (cvIndex) {
-    case 8:
-      if (newValue == 8) {
-        // Total reset of everything
-        // There is special logic in the standard for when the reset takes longer, but we don't need that here.
-        colors::restoreDefaultColorsToEeprom();
-        config::resetConfigurationToDefault();
-        return true;
-      }
+bool writeCvValues(uint16_t firstCvIndex, const uint8_t *newValues, uint8_t count) {
+  switch (cvtable::writeBlock(firstCvIndex, newValues, count)) {
+    case cvtable::WRITE_REJECTED:
       return false;
+    case cvtable::WRITE_FACTORY_RESET:
+      // There is special logic in the standard for when the reset takes longer, but we don't need that here.
+      factoryReset();
+      break;
+    case cvtable::WRITE_CHANGES_COLORS:
+      colors::updateOutputColors();
+      break;
     default:
-      return config::setValueForCv(cvIndex, newValue);
+      break;
   }
+  // Address or number of signal heads may have changed
+  updatePacketFilter();
+  packetcache::flush();
+  redrawLeds();
+  return true;
 }
 
 void sendProgrammingAck() {
@@ -133,21 +142,25 @@ void sendProgrammingAck() {
   }
 #ifdef ACK_VIA_LEDS
   // Increase power consumption (and hope this is enough…)
-  memset(signalHeadColors, 255, config::values.activeSignalHeads*3);
-  ws2812_sendarray_mask(signalHeadColors, config::values.activeSignalHeads*3, PIN_LED);
+  signalBank.fill(255);
+  hal::sendLeds(signalBank.leds, activeLedBytes());
 #else
-  PORTB |= ACK_PIN_MASK;
+  hal::setAckPin(true);
 #endif
 
   decoderMode = DECODER_MODE_SENDING_ACK;
   
   // Timer 1: Turn off increased power after 5-7 ms
-  OCR1A = WAIT_TIME_ACK;
-  TCNT1 = 0;
-  TCCR1 = (1 << CTC1) | (1 << CS13) | (1 << CS11) | (1 << CS10); // Normal mode, clear on OCR1A match, run immediately with CLK/1024
-  TIMSK |= (1 << OCIE1A); // Interrupts on
+  hal::startAckTimer();
 
-  sei();
+  hal::enableInterrupts();
+}
+
+// Writes only get acknowledged once they are in the EEPROM; loop() sends the ACK then.
+bool ackWhenWritten = false;
+
+void sendProgrammingAckWhenWritten() {
+  ackWhenWritten = true;
 }
 
 // Message stored by the decoder in programming mode; length = 0 if not used.
@@ -184,7 +197,7 @@ void processRegisterModeMessage() {
       if (lastProgrammingMessage.data[0] & 0x8) {
         // Write byte
         if (writeCvValue(cv, lastProgrammingMessage.data[1])) {
-          sendProgrammingAck();
+          sendProgrammingAckWhenWritten();
         }
       } else {
         // Verify byte
@@ -195,6 +208,66 @@ void processRegisterModeMessage() {
     }
 }
 
+// Bit manipulation: 111K-DBBB, K=0 verify, K=1 write bit B with value D
+void processBitManipulation(uint16_t cv, uint8_t operation) {
+  if ((operation & 0xE0) != 0xE0) {
+    return;
+  }
+  uint8_t bitIndex = operation & 0x7;
+  uint8_t setBit = 1 << bitIndex;
+  uint8_t bitValue = (operation & 0x8) >> 3;
+  if ((operation & 0x10) == 0) {
+    // Verify bit
+    // Recommendation in RCN214: Confirm any bit value for CVs we don't have
+    uint16_t value = getCvValue(cv);
+    if (value > 0xFF || ((uint8_t(value) & setBit) == uint8_t(bitValue << bitIndex))) {
+      sendProgrammingAck();
+    }
+  } else {
+    // Write bit
+    uint16_t newValue = getCvValue(cv);
+    if (newValue <= 0xFF && (setBit & cvtable::writeMask(cv))) {
+      uint8_t newValueByte = uint8_t(newValue & 0xFF);
+      if (bitValue) {
+        newValueByte |= setBit;
+      } else {
+        newValueByte &= ~setBit;
+      }
+      if (writeCvValue(cv, newValueByte)) {
+        sendProgrammingAckWhenWritten();
+      }
+    }
+  }
+}
+
+// XPOM (RCN-214): 1110-GGSS, a 24 bit CV index and one to four values. SS counts up with
+// every new command, so a repeat is exactly the same packet. Reading needs RailCom, which
+// this decoder doesn't have.
+void processXpomMessage() {
+  const uint8_t *data = lastProgrammingMessage.data;
+  // Without the instruction, the CV index and the XOR byte
+  const uint8_t valueCount = lastProgrammingMessage.length - 5;
+  if (data[1] != 0) {
+    // Far beyond our CVs
+    return;
+  }
+  uint16_t cv = (uint16_t(data[2]) << 8 | data[3]) + 1;
+
+  switch (data[0] & 0xC) {
+    case 0xC:
+      // Write bytes, all in one go
+      if (writeCvValues(cv, &data[4], valueCount)) {
+        sendProgrammingAckWhenWritten();
+      }
+      break;
+    case 0x8:
+      if (valueCount == 1) {
+        processBitManipulation(cv, data[4]);
+      }
+      break;
+  }
+}
+
 // Aufgerufen wenn wir im Programmiermodus sind und die Nachricht eine Programmiernachricht ist
 void processProgrammingMessage(const volatile uint8_t *relevantMessage, uint8_t messageLength) {
   // Compare and copy
@@ -215,6 +288,11 @@ void processProgrammingMessage(const volatile uint8_t *relevantMessage, uint8_t
     return;
   }
   
+  if (lastProgrammingMessage.length >= 6 && lastProgrammingMessage.length <= 9 && (lastProgrammingMessage.data[0] & 0xF0) == 0xE0) {
+    processXpomMessage();
+    return;
+  }
+
   if (lastProgrammingMessage.length != 4) {
     return;
   }
@@ -232,74 +310,91 @@ void processProgrammingMessage(const volatile uint8_t *relevantMessage, uint8_t
     case 0xC:
       // Write byte
       if (writeCvValue(cv, lastProgrammingMessage.data[2])) {
-        sendProgrammingAck();
+        sendProgrammingAckWhenWritten();
       }
       break;
     case 0x8:
-      if ((lastProgrammingMessage.data[2] & 0xE0) == 0xE0) {
-        // Bit manipulation
-        uint8_t bitIndex = lastProgrammingMessage.data[2] & 0x7;
-        uint8_t setBit = 1 << bitIndex;
-        uint8_t bitValue = (lastProgrammingMessage.data[2] & 0x8) >> 3;
-        if ((lastProgrammingMessage.data[2] & 0x10) == 0) {
-          // Verify bit
-          // Recommendation in RCN214: Confirm any bit value for CVs we don't have
-          uint16_t value = getCvValue(cv);
-          if (value > 0xFF || ((uint8_t(value) & setBit) == uint8_t(bitValue << bitIndex))) {
-            sendProgrammingAck();
-          }
-        } else {
-          // Write bit
-          uint16_t newValue = getCvValue(cv);
-          if (newValue <= 0xFF && (setBit & config::writeMaskForCv(cv))) {
-            uint8_t newValueByte = uint8_t(newValue & 0xFF);
-            if (bitValue) {
-              newValueByte |= setBit;
-            } else {
-              newValueByte &= ~setBit;
-            }
-            if (writeCvValue(cv, newValueByte)) {
-              sendProgrammingAck();
-            }
-          }
-        }
-      }
+      processBitManipulation(cv, lastProgrammingMessage.data[2]);
       break;
   }
 }
 
-inline void parseNewMessage() {
+void parseNewMessage(const dccdecode::Message &message) {
   if (decoderMode == DECODER_MODE_SENDING_ACK) {
     // There's an ACK currently going out so ignore all messages (which are just other "Programming" messages anyway)
     return;
   }
 
-  if (dccdecode::message.isGeneralReset()) {
+  if (decoderMode == DECODER_MODE_OPERATION && packetcache::isRepeat(message, animationTimestep)) {
+    // The command station repeating a packet we already handled
+    return;
+  }
+
+  if (message.isGeneralReset()) {
     // General reset command
     if (decoderMode == DECODER_MODE_OPERATION) {
-      TCCR1 = 0; // Stop timer
+      SignalHead::stopAnimationTimer();
       turnLedsOff();
       lastProgrammingMessage.length = 0;
       decoderMode = DECODER_MODE_RESET_RECEIVED;
+      updatePacketFilter();
+      packetcache::flush();
     }
     return;
   }
 
-  if (decoderMode != DECODER_MODE_OPERATION && dccdecode::message.isPossiblyProgramming()) {
+  if (decoderMode != DECODER_MODE_OPERATION && message.isPossiblyProgramming()) {
     decoderMode = DECODER_MODE_PROGRAMMING;
-    processProgrammingMessage(dccdecode::message.data, dccdecode::message.length);
+    processProgrammingMessage(message.data, message.length);
     return;
   }
 
-  if (decoderMode != DECODER_MODE_EMERGENCY_STOP) {
+  if (decoderMode != DECODER_MODE_EMERGENCY_STOP && decoderMode != DECODER_MODE_OPERATION) {
     decoderMode = DECODER_MODE_OPERATION;
+    updatePacketFilter();
+    // The LEDs were turned off for programming
+    SignalHead::startAnimationTimer();
   }
 
-  if (dccdecode::message.isBasicAccessoryMessage()) {
+  if (message.isExtendedAccessoryMessage()) {
+    // Extended accessory decoder: 10AA-AAAA 0AAA-0AA1 DDDD-DDDD
+    // One output address per signal head, with the whole aspect in one packet.
+    uint8_t firstHead = 0;
+    uint8_t headCount = config::values.activeSignalHeads;
+    if (!message.isAccessoryBroadcast()) {
+      uint16_t outputAddress = message.getAccessoryOutputAddress();
+      if (outputAddress < config::values.address ||
+        outputAddress >= config::values.address + config::values.activeSignalHeads) {
+        return;
+      }
+      // Invert number so signal head 0 is the top one
+      firstHead = config::values.activeSignalHeads - 1 - uint8_t(outputAddress - config::values.address);
+      headCount = 1;
+    }
+    uint8_t aspectNumber = message.data[2];
+    if (aspectNumber >= config::ASPECT_COUNT) {
+      return;
+    }
+    dccdecode::countAddressedPacket();
+    packetcache::stateChanged();
+    if (decoderMode != DECODER_MODE_OPERATION) {
+      // Back from emergency stop, so the LEDs need to be turned on again
+      decoderMode = DECODER_MODE_OPERATION;
+      SignalHead::startAnimationTimer();
+    }
+
+    uint8_t aspect = config::values.aspects[aspectNumber];
+    for (uint8_t i = firstHead; i < firstHead + headCount; i++) {
+      signalBank.heads[i].setAspect(colors::ColorName(aspect & config::ASPECT_COLOR_MASK), aspect & config::ASPECT_BIT_FLASHING);
+    }
+    return;
+  }
+
+  if (message.isBasicAccessoryMessage()) {
     // Basic accessory decoder: 10AA-AAAA 1AAA-DAAR
     // Address format is weird. See RCN213.
-    uint16_t decoderAddress = (dccdecode::message.data[0] & 0x3F) | (0x7 & ~((dccdecode::message.data[1] & 0x70) >> 4));
-    uint8_t port = (dccdecode::message.data[1] & 0x6) >> 1;
+    uint16_t decoderAddress = (message.data[0] & 0x3F) | (0x7 & ~((message.data[1] & 0x70) >> 4));
+    uint8_t port = (message.data[1] & 0x6) >> 1;
     uint16_t outputAddress = (decoderAddress << 2 | port) - 3;
 
     /*
@@ -310,17 +405,18 @@ inline void parseNewMessage() {
      * decoder addres = 10, port = 0
      * Not sure why, it's very annoying.
      */
-    bool direction = dccdecode::message.data[1] & 0x1;
-    bool bitC = dccdecode::message.data[1] & 0x8; // For normal mode: "turn on/off". For PoM: "whole decoder/single output"
+    bool direction = message.data[1] & 0x1;
+    bool bitC = message.data[1] & 0x8; // For normal mode: "turn on/off". For PoM: "whole decoder/single output"
     // Note that RCN 214 deprecates this use of bitC for PoM, but my ESU command station still uses it, so it stays.
     if (outputAddress == 2047 && !direction && !bitC) {
       // Emergency turn off. Not sure it helps if the signal goes dark but why not.
       turnLedsOff();
       decoderMode = DECODER_MODE_EMERGENCY_STOP;
+      packetcache::flush();
       return;
     }
 
-    if (dccdecode::message.length == 6 && (dccdecode::message.data[2] & 0xF0) == 0xE0) {
+    if (message.isAccessoryPom()) {
       // POM, but is it our address?
       if ((config::values.workarounds & config::WORKAROUND_BIT_POM_ADDRESSING) && !bitC) {
         // Workaround: When switching "10", ESU command stations send "decoder 2 port 2" or whatever,
@@ -337,7 +433,8 @@ inline void parseNewMessage() {
           return;
         }
       }
-      processProgrammingMessage(&dccdecode::message.data[2], dccdecode::message.length - 2);
+      dccdecode::countAddressedPacket();
+      processProgrammingMessage(&message.data[2], message.length - 2);
       return;
     }
 
@@ -346,7 +443,12 @@ inline void parseNewMessage() {
       outputAddress >= config::values.address + config::values.activeSignalHeads * 3) {
       return;
     }
-    decoderMode = DECODER_MODE_OPERATION;
+    dccdecode::countAddressedPacket();
+    if (decoderMode != DECODER_MODE_OPERATION) {
+      // Back from emergency stop, so the LEDs need to be turned on again
+      decoderMode = DECODER_MODE_OPERATION;
+      SignalHead::startAnimationTimer();
+    }
     
     if (!bitC) {
       // Message with flag C=0/turnOff gets sent whenever the command station thinks we've sent power
@@ -356,6 +458,7 @@ inline void parseNewMessage() {
       // TODO But if we were to add Railcom then this would be a place where we'd need to ack.
       return;
     }
+    packetcache::stateChanged();
 
     uint8_t relativeAddress = uint8_t(outputAddress - config::values.address);
     uint8_t signalHead = relativeAddress/3;
@@ -364,66 +467,70 @@ inline void parseNewMessage() {
     uint8_t invertedSignalHead = config::values.activeSignalHeads - 1 - signalHead;
     if (relativeField == 0) {
       // dir=0: red, dir=1: green
-      signalHeads[invertedSignalHead].setColor(direction ? colors::GREEN : colors::RED);
+      signalBank.heads[invertedSignalHead].setColor(direction ? colors::GREEN : colors::RED);
     } else if (relativeField == 1) {
       // dir=0: lunar, dir=1: yellow
-      signalHeads[invertedSignalHead].setColor(direction ? colors::YELLOW : colors::LUNAR);
+      signalBank.heads[invertedSignalHead].setColor(direction ? colors::YELLOW : colors::LUNAR);
     } else if (relativeField == 2) {
       // dir=0: flashing off, dir=1: flashing on
-      signalHeads[invertedSignalHead].setFlashing(direction);
+      signalBank.heads[invertedSignalHead].setFlashing(direction);
     }
   }
 }
 
 uint8_t lastAnimationTimestep = 1;
-inline bool updateAnimation() {
+bool updateAnimation() {
   if (animationTimestep == lastAnimationTimestep) {
     return false;
   }
 
-  lastAnimationTimestep = animationTimestep;
+  if (hal::ledsBusy()) {
+    // The last frame is still going out between DCC bits; without a DCC signal it never will
+    if (uint8_t(animationTimestep - lastAnimationTimestep) < 2) {
+      return false;
+    }
+    hal::finishLeds();
+  }
 
-  for (int i = 0; i < config::values.activeSignalHeads; i++) {
-    uint8_t *color = &signalHeadColors[i*3];
-    signalHeads[i].updateColor(color);
+  lastAnimationTimestep = animationTimestep;
 
-    if (config::values.colorOrder == config::Configuration::COLOR_ORDER_GRB) {
-      // Swap colors for WS2812
-      uint8_t red = color[0];
-      uint8_t green = color[1];
-      color[0] = green;
-      color[1] = red;
-    }
-    if (config::values.brightness < config::BRIGHTNESS_MAX) {
-      color[0] = (uint16_t(color[0]) * config::values.brightness) / config::BRIGHTNESS_MAX;
-      color[1] = (uint16_t(color[1]) * config::values.brightness) / config::BRIGHTNESS_MAX;
-      color[2] = (uint16_t(color[2]) * config::values.brightness) / config::BRIGHTNESS_MAX;
-    }
+  // Brightness and color order are already part of colors::outputColorValues
+  uint8_t changedLength = signalBank.update(config::values.activeSignalHeads);
+  if (changedLength > 0) {
+    hal::sendLeds(signalBank.leds, changedLength);
   }
-  ws2812_sendarray_mask(signalHeadColors, config::values.activeSignalHeads*3, PIN_LED);
 
   return true;
 }
 
-inline void loop() {
+void loop() {
   bool didSomething = false;
-  if (dccdecode::hasNewMessage()) {
-    parseNewMessage();
+  dccdecode::Message message;
+  if (dccdecode::popMessage(message)) {
+    parseNewMessage(message);
     didSomething = true;
   }
   if (decoderMode == DECODER_MODE_OPERATION && updateAnimation()) {
     didSomething = true;
   }
+  if (ackWhenWritten && !hal::eepromWritesPending()) {
+    ackWhenWritten = false;
+    sendProgrammingAck();
+    didSomething = true;
+  }
 
   if (!didSomething) {
-    MCUCR |= (1 << SE); // Sleep enable, sleep mode 000 = Idle
-    sleep_cpu();
+    hal::sleep();
   }
 }
 
+// Unit tests bring their own main and call setup() and loop() as needed, and so do host tools
+// built with the firmware (FIRMWARE_WITHOUT_MAIN).
+#if !defined(PIO_UNIT_TESTING) && !defined(FIRMWARE_WITHOUT_MAIN)
 int main() {
   setup();
   for(;;) {
     loop();
   }
 }
+#endif
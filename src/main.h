@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <dccdecode.h>
+
+// The firmware's entry points, so native tests can run it without a device. See hal.h for
+// how the hardware gets simulated there.
+
+void setup();
+// Handles one received message and, if it is time, the next animation frame; sleeps if
+// neither happened.
+void loop();
+
+void parseNewMessage(const dccdecode::Message &message);
+// Calculates and sends the next frame if the animation timer fired since the last one.
+// Returns whether it did.
+bool updateAnimation();
+
+// Values <= 255 are actual values, anything else means "CV not supported"
+uint16_t getCvValue(uint16_t cvIndex);
+bool writeCvValue(uint16_t cvIndex, uint8_t newValue);
+// Writes count consecutive CVs, all or none of them
+bool writeCvValues(uint16_t firstCvIndex, const uint8_t *newValues, uint8_t count);
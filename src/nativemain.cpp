@@ -1,4 +0,0 @@
-// Main for native platform. Native is only used for unit tests here so this main is empty
-#ifndef __AVR_ARCH__
-int main() {}
-#endif
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "packetcache.h"
+
+#include <string.h>
+
+namespace packetcache {
+
+struct Entry {
+    // The XOR byte of the packet, which already is a hash of the others
+    uint8_t key;
+    // 0 for unused entries
+    uint8_t length;
+    uint8_t data[MAX_PACKET_LENGTH - 1];
+    uint8_t frame;
+};
+
+Entry entries[LENGTH];
+// Where the next packet goes, so the one before is the newest
+uint8_t nextEntry = 0;
+
+Statistics statistics;
+
+static void countEvent(uint16_t &counter) {
+    if (counter != 0xFFFF) {
+        counter += 1;
+    }
+}
+
+static bool isCacheable(const dccdecode::Message &message) {
+    if (message.isExtendedAccessoryMessage()) {
+        return true;
+    }
+    // Basic accessory POM packets are longer
+    return message.isBasicAccessoryMessage() && message.length == 3;
+}
+
+bool isRepeat(const dccdecode::Message &message, uint8_t frame) {
+    if (!isCacheable(message)) {
+        return false;
+    }
+    countEvent(statistics.checkedPackets);
+
+    const uint8_t dataLength = message.length - 1;
+    const uint8_t key = message.data[dataLength];
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        const Entry &entry = entries[i];
+        if (entry.key == key && entry.length == message.length && memcmp(entry.data, message.data, dataLength) == 0) {
+            if (uint8_t(frame - entry.frame) < EXPIRY_FRAMES) {
+                countEvent(statistics.droppedRepeats);
+                return true;
+            }
+        }
+    }
+
+    Entry &entry = entries[nextEntry];
+    entry.key = key;
+    entry.length = message.length;
+    memcpy(entry.data, message.data, dataLength);
+    entry.frame = frame;
+    nextEntry = (nextEntry + 1) % LENGTH;
+    return false;
+}
+
+void stateChanged() {
+    const uint8_t newest = (nextEntry + LENGTH - 1) % LENGTH;
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        if (i != newest) {
+            entries[i].length = 0;
+        }
+    }
+}
+
+void flush() {
+    for (uint8_t i = 0; i < LENGTH; i++) {
+        entries[i].length = 0;
+    }
+}
+
+Statistics getStatistics() {
+    return statistics;
+}
+
+void resetStatistics() {
+    statistics = Statistics();
+}
+
+}
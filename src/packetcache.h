@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include "dccdecode.h"
+
+// Accessory packets that were handled recently. Command stations send every accessory packet
+// several times in a row; the main loop uses this to drop the repeats before even decoding
+// the address.
+//
+// Only basic accessory commands and extended accessory packets get cached, never POM or
+// service mode packets, which have to arrive twice to count. Any entry is only valid as long
+// as the decoder is in the state it was in when the packet arrived: a repeat of an older
+// packet may undo what a newer one did. So whatever changes that state has to call
+// stateChanged() or flush().
+
+// Number of packets remembered. Packets for other decoders within the packet filter's
+// window take up entries as well.
+#ifndef PACKETCACHE_LENGTH
+#define PACKETCACHE_LENGTH 4
+#endif
+
+namespace packetcache {
+
+const uint8_t LENGTH = PACKETCACHE_LENGTH;
+static_assert(LENGTH > 0, "Packet cache needs at least one entry");
+
+// Animation frames after which an entry is no longer a repeat, about half a second. Frames
+// don't advance while the animation timer is stopped, but then nothing happens that a repeat
+// could undo either.
+const uint8_t EXPIRY_FRAMES = 25;
+
+// Longest packet that gets cached, with the XOR byte
+const uint8_t MAX_PACKET_LENGTH = 4;
+
+// Counters since the start, stopping at 0xFFFF
+struct Statistics {
+    uint16_t checkedPackets = 0; // Packets that could have been repeats
+    uint16_t droppedRepeats = 0;
+};
+
+// Returns true if the same packet was seen within the last EXPIRY_FRAMES frames. Otherwise
+// remembers it (replacing the oldest entry) and returns false. frame is the current
+// animation frame counter.
+bool isRepeat(const dccdecode::Message &message, uint8_t frame);
+
+// The packet remembered last changed the state of the decoder, so repeats of anything
+// before it must not be dropped any more.
+void stateChanged();
+
+// Forgets everything, e.g. after the configuration changed.
+void flush();
+
+Statistics getStatistics();
+void resetStatistics();
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <animation.h>
+#include <flash.h>
+
+// The animations SignalHead plays
+
+const uint8_t TIMESTEPS_FULLY_ON = 2;
+const uint8_t TIMESTEPS_TURNING_OFF = 20;
+const uint8_t TIMESTEPS_FULLY_OFF = 4;
+const uint8_t TIMESTEPS_TURNING_ON = 20;
+
+const uint8_t COLOR_SWITCHING_TIME = 20;
+const uint8_t COLOR_SWITCHING_INTERMEDIATE_RED_TIME = 1;
+
+namespace signalanimations {
+    using animation::A;
+    using animation::B;
+    using animation::fade;
+    using animation::show;
+    using animation::hold;
+
+    constexpr animation::Selector OFF = animation::palette(colors::UNDEFINED);
+    constexpr animation::Selector RED = animation::palette(colors::RED);
+
+    // A is on, B is off. SignalHead plays this once for each palette color, all heads in the
+    // same phase.
+    constexpr animation::Step FLASHING[] = {
+        show(TIMESTEPS_FULLY_ON, A).completed(),
+        fade(TIMESTEPS_TURNING_OFF, A, B),
+        show(TIMESTEPS_FULLY_OFF, B),
+        fade(TIMESTEPS_TURNING_ON, B, A).thenRepeatFrom(0),
+    };
+
+    // Color change directly. A is start color, B is end color
+    constexpr animation::Step SWITCH_DIRECT[] = {
+        fade(COLOR_SWITCHING_TIME/2, A, OFF),
+        fade(COLOR_SWITCHING_TIME/2, OFF, B),
+        hold(B),
+    };
+
+    // Color change with intermediate red. A is start, B is end
+    constexpr animation::Step SWITCH_INTERMEDIATE_RED[] = {
+        fade(COLOR_SWITCHING_TIME/4, A, OFF),
+        fade(COLOR_SWITCHING_TIME/4, OFF, RED),
+        show(COLOR_SWITCHING_INTERMEDIATE_RED_TIME, RED),
+        fade(COLOR_SWITCHING_TIME/4, RED, OFF),
+        fade(COLOR_SWITCHING_TIME/4, OFF, B),
+        hold(B),
+    };
+
+    // No change going on, B is the current color
+    constexpr animation::Step SWITCH_DONE[] = {
+        hold(B),
+    };
+
+    // In flash; AnimationPlayer reads the phases with flash::read()
+    inline constexpr auto table PROGMEM = animation::compile(FLASHING, SWITCH_DIRECT, SWITCH_INTERMEDIATE_RED, SWITCH_DONE);
+    static_assert(table.colorsValid, "Animation uses a color that does not exist");
+    static_assert(table.lengthsValid, "Animation phase is empty or too long");
+    static_assert(table.jumpsValid, "Animation repeats from a step it does not have or runs past its end");
+}
+
+const uint8_t ANIMATION_START_FLASHING = signalanimations::table.start[0];
+const uint8_t ANIMATION_START_SWITCH_DIRECT = signalanimations::table.start[1];
+const uint8_t ANIMATION_START_SWITCH_INTERMEDIATE_RED = signalanimations::table.start[2];
+const uint8_t ANIMATION_SWITCH_DONE = signalanimations::table.start[3];
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <signalhead.h>
+
+// A number of signal heads and the WS2812 chain that shows them. By default, each head has
+// LedsPerHead LEDs next to each other in the chain, but the LED mapping (one entry per LED)
+// can assign any head to any LED. LEDs assigned to a head that does not exist or is not
+// active stay dark.
+template<uint8_t Heads, uint8_t LedsPerHead>
+class SignalBank {
+public:
+    static const uint8_t HEAD_COUNT = Heads;
+    static const uint8_t LED_COUNT = Heads * LedsPerHead;
+    static_assert(uint16_t(Heads) * LedsPerHead * 3 <= 255, "LED buffer has to be addressable with eight bits");
+
+    SignalHead heads[Heads];
+    // What gets sent to the LEDs, three bytes per LED in chain order
+    uint8_t leds[LED_COUNT * 3];
+
+    explicit SignalBank(const uint8_t *ledMapping);
+
+    // Sets all LEDs to the value, e.g. to turn them off. The next update() sends all of them
+    // again.
+    void fill(uint8_t value);
+    // The next update() sends all LEDs, e.g. because the mapping changed.
+    void redraw();
+
+    // Calculates the next frame for the first activeHeads heads and the LEDs they have
+    // (activeHeads * LedsPerHead). Returns how many bytes from the start of leds need to be
+    // sent, which is 0 if nothing changed; LEDs past that keep their values.
+    // Stops the animation timer once all heads are idle; setColor() and setFlashing() start
+    // it again.
+    uint8_t update(uint8_t activeHeads);
+
+private:
+    const uint8_t *ledMapping;
+    // Output of each head, three bytes each
+    uint8_t headColors[Heads * 3];
+    bool redrawAll;
+};
+
+template<uint8_t Heads, uint8_t LedsPerHead>
+SignalBank<Heads, LedsPerHead>::SignalBank(const uint8_t *ledMapping)
+: leds(),
+ledMapping(ledMapping),
+headColors(),
+redrawAll(true)
+{
+}
+
+template<uint8_t Heads, uint8_t LedsPerHead>
+void SignalBank<Heads, LedsPerHead>::fill(uint8_t value) {
+    memset(leds, value, sizeof(leds));
+    redrawAll = true;
+}
+
+template<uint8_t Heads, uint8_t LedsPerHead>
+void SignalBank<Heads, LedsPerHead>::redraw() {
+    redrawAll = true;
+}
+
+template<uint8_t Heads, uint8_t LedsPerHead>
+uint8_t SignalBank<Heads, LedsPerHead>::update(uint8_t activeHeads) {
+    SignalHead::updateFlashingPhase();
+
+    bool allIdle = true;
+    bool changed[Heads];
+    for (uint8_t i = 0; i < activeHeads; i++) {
+        // Checked before the update: A head that only just finished still has to draw its
+        // final color in this frame.
+        allIdle = allIdle && heads[i].isIdle();
+        changed[i] = heads[i].updateColor(&headColors[i*3]) || redrawAll;
+    }
+
+    if (allIdle) {
+        SignalHead::stopAnimationTimer();
+    }
+
+    uint8_t changedLength = 0;
+    const uint8_t activeLeds = activeHeads * LedsPerHead;
+    for (uint8_t led = 0; led < activeLeds; led++) {
+        const uint8_t head = ledMapping[led];
+        if (head < activeHeads) {
+            if (!changed[head]) {
+                continue;
+            }
+            memcpy(&leds[led*3], &headColors[head*3], 3);
+        } else if (redrawAll) {
+            memset(&leds[led*3], 0, 3);
+        } else {
+            continue;
+        }
+        // The WS2812 chain latches whatever it got, so only send up to the last change
+        changedLength = (led + 1) * 3;
+    }
+
+    redrawAll = false;
+    return changedLength;
+}
@@ -1,71 +1,98 @@
 #include "signalhead.h"
+#include "signalanimations.h"
+
+#include "hal.h"
 
-#include <avr/interrupt.h>
 #include <string.h>
 
-const uint8_t TIMESTEPS_FULLY_ON = 2;
-const uint8_t TIMESTEPS_TURNING_OFF = 20;
-const uint8_t TIMESTEPS_FULLY_OFF = 4;
-const uint8_t TIMESTEPS_TURNING_ON = 20;
-
-const uint8_t COLOR_SWITCHING_TIME = 20;
-const uint8_t COLOR_SWITCHING_INTERMEDIATE_RED_TIME = 1;
-
-const uint8_t ANIMATION_START_FLASHING = 0;
-const uint8_t ANIMATION_START_SWITCH_DIRECT = 5;
-const uint8_t ANIMATION_SWITCH_DONE = 7;
-const uint8_t ANIMATION_START_SWITCH_INTERMEDIATE_RED = 8;
-
-const AnimationPhase animations[] = {
-    // Flashing: A is signal color
-    { TIMESTEPS_FULLY_ON, 0x80 | 0x00 },
-    { TIMESTEPS_TURNING_OFF, 0x06 },
-    { TIMESTEPS_FULLY_OFF, 0x66 },
-    { TIMESTEPS_TURNING_ON, 0x60 },
-    { -4, 0x00 },
-
-    // Color change directly. A is start color, B is end color
-    { COLOR_SWITCHING_TIME/2, 0x06 },
-    { COLOR_SWITCHING_TIME/2, 0x61 },
-    { 127, 0x80 | 0x11 },
-
-    // Color change with intermediate red. A is start, B is end
-    { COLOR_SWITCHING_TIME/4, 0x06 },
-    { COLOR_SWITCHING_TIME/4, 0x62 },
-    { COLOR_SWITCHING_INTERMEDIATE_RED_TIME, 0x22 },
-    { COLOR_SWITCHING_TIME/4, 0x26 },
-    { COLOR_SWITCHING_TIME/4, 0x61 },
-    { 127, 0x80 | 0x11 },
+const AnimationPhase *const animations = signalanimations::table.phases;
+
+static bool animationTimerRunning = false;
+
+AnimationPlayer SignalHead::flashingPhase[colors::UNDEFINED] = {
+    AnimationPlayer(ANIMATION_START_FLASHING), AnimationPlayer(ANIMATION_START_FLASHING),
+    AnimationPlayer(ANIMATION_START_FLASHING), AnimationPlayer(ANIMATION_START_FLASHING)
 };
+static_assert(colors::UNDEFINED == 4, "One flashing player per palette color");
+colors::ColorRGB SignalHead::flashingColors[colors::UNDEFINED];
+uint8_t SignalHead::flashingColorsReady = 0;
+bool SignalHead::flashingPhaseComplete = true;
+bool SignalHead::flashingPhaseShown = false;
 
 void SignalHead::setupTimer1() {
-    // The ISR is not here but in main because it needs to do different things depending on stuff
+    // The interrupt handler is not here but in main because it needs to do different things depending on stuff
+    hal::startAnimationTimer();
+    animationTimerRunning = true;
+}
+
+void SignalHead::startAnimationTimer() {
+    if (!animationTimerRunning) {
+        setupTimer1();
+    }
+}
+
+void SignalHead::stopAnimationTimer() {
+    hal::stopTimer1();
+    animationTimerRunning = false;
+}
 
-    // Run roughly every twenty milliseconds
-    OCR1A = 156;
-    TCNT1 = 0;
-    TCCR1 = (1 << CS13) | (1 << CS11) | (1 << CS10); // Normal mode, clear on OCR1A match, run immediately with CLK/1024
-    TIMSK |= (1 << OCIE1A); // Interrupts on
+bool SignalHead::isAnimationTimerRunning() {
+    return animationTimerRunning;
 }
 
 SignalHead::SignalHead()
 : switchingFrom(colors::RED),
 switchingTo(colors::RED),
-nextAfter(colors::UNDEFINED),
 isFlashing(false),
-colorSwitching(ANIMATION_SWITCH_DONE),
-flashing(ANIMATION_START_FLASHING)
+finishingFlash(false),
+nextAfter(colors::UNDEFINED),
+colorSwitching(ANIMATION_SWITCH_DONE)
 {
 }
 
+void SignalHead::updateFlashingPhase() {
+    if (flashingPhaseShown) {
+        for (uint8_t i = 0; i < colors::UNDEFINED; i++) {
+            if (flashingColorsReady & (1 << i)) {
+                flashingPhase[i].advance();
+            } else {
+                flashingPhase[i].skip();
+            }
+        }
+        flashingPhaseShown = false;
+    }
+    flashingColorsReady = 0;
+    flashingPhaseComplete = flashingPhase[0].isComplete();
+}
+
+// The same steps a player of each head's own would take, once per frame for all heads
+// flashing this color
+const uint8_t *SignalHead::flashingColor(uint8_t color) {
+    if (!(flashingColorsReady & (1 << color))) {
+        flashingPhase[color].currentColor((const uint8_t *) &colors::outputColorValues[color], (const uint8_t *) &colors::outputColorValues[colors::UNDEFINED], (uint8_t *) &flashingColors[color]);
+        flashingColorsReady |= 1 << color;
+    }
+    return (const uint8_t *) &flashingColors[color];
+}
+
 void SignalHead::setColor(colors::ColorName color) {
-    if (switchingTo != color) {
+    if (colors::ColorName(switchingTo) != color) {
         nextAfter = color;
+        startAnimationTimer();
     }
 }
 
-void SignalHead::updateColor(uint8_t *colors) {
-    colorSwitching.updateColor((const uint8_t *) &colors::colorValues[switchingFrom], (const uint8_t *) &colors::colorValues[switchingTo], colors);
+bool SignalHead::isIdle() {
+    return nextAfter == colors::UNDEFINED && colorSwitching.isComplete() && !isFlashing && !finishingFlash;
+}
+
+bool SignalHead::updateColor(uint8_t *colors) {
+    const uint8_t previous[3] = { colors[0], colors[1], colors[2] };
+    // Complete phases hold switchingTo exactly, so the head shows that palette color
+    const bool showsPaletteColor = colorSwitching.isComplete() && switchingTo != colors::UNDEFINED;
+    const uint8_t paletteColor = switchingTo;
+
+    colorSwitching.updateColor((const uint8_t *) &colors::outputColorValues[switchingFrom], (const uint8_t *) &colors::outputColorValues[switchingTo], colors);
 
     if (colorSwitching.isComplete() && nextAfter != colors::UNDEFINED) {
         switchingFrom = switchingTo;
@@ -79,7 +106,18 @@ void SignalHead::updateColor(uint8_t *colors) {
         colorSwitching.setAnimation(newAnimationIndex);
     }
 
-    if (isFlashing || !flashing.isComplete()) {
-        flashing.updateColor(colors, (const uint8_t *) &colors::colorValues[colors::UNDEFINED], colors);
+    if (finishingFlash && !isFlashing && flashingPhaseComplete) {
+        finishingFlash = false;
     }
+    if (isFlashing || finishingFlash) {
+        if (showsPaletteColor) {
+            memcpy(colors, flashingColor(paletteColor), 3);
+        } else {
+            // Switching colors while flashing, rare enough to divide
+            flashingPhase[0].dividedColor(colors, (const uint8_t *) &colors::outputColorValues[colors::UNDEFINED], colors);
+        }
+        flashingPhaseShown = true;
+    }
+
+    return memcmp(previous, colors, sizeof(previous)) != 0;
 }
@@ -8,23 +8,71 @@ class SignalHead {
 public:
     void setColor(colors::ColorName color);
     void setFlashing(bool flashing);
+    // Both at once, so no frame shows the new color with the old flashing or vice versa
+    void setAspect(colors::ColorName color, bool flashing);
 
-    void updateColor(uint8_t *color);
+    // Returns whether any of the three bytes changed. Call updateFlashingPhase() first.
+    bool updateColor(uint8_t *color);
+    // Whether the color stays the same until the next setColor() or setFlashing()
+    bool isIdle();
 
     SignalHead();
 
+    // All heads flash in the same phase. Call once per frame before the heads' updateColor().
+    // Advances the phase if any head showed it in the last frame.
+    static void updateFlashingPhase();
+
+    // Timer1 drives the animations, but only runs while there is something to animate.
     static void setupTimer1();
+    static void startAnimationTimer();
+    static void stopAnimationTimer();
+    static bool isAnimationTimerRunning();
 
 private:
-    colors::ColorName switchingFrom = colors::RED;
-    colors::ColorName switchingTo = colors::RED;
-    colors::ColorName nextAfter = colors::UNDEFINED;
-    bool isFlashing = false;
+    // Packed into two bytes to save RAM. The colors are colors::ColorName values.
+    uint8_t switchingFrom : 3;
+    uint8_t switchingTo : 3;
+    uint8_t isFlashing : 1;
+    // Flashing got turned off, but the flashing phase has not come back to full brightness yet
+    uint8_t finishingFlash : 1;
+    uint8_t nextAfter : 3;
 
     AnimationPlayer colorSwitching;
-    AnimationPlayer flashing;
+
+    // The flashing animation once for each palette color, blending it with colors::UNDEFINED.
+    // All run in the same phase. A head that shows a palette color takes its color from
+    // here, without any blending of its own.
+    static AnimationPlayer flashingPhase[colors::UNDEFINED];
+    static colors::ColorRGB flashingColors[colors::UNDEFINED];
+    // Bit for each of flashingColors that holds the current timestep
+    static uint8_t flashingColorsReady;
+    static bool flashingPhaseComplete;
+    // Some head showed the current timestep, so the next frame gets the next one
+    static bool flashingPhaseShown;
+
+    static const uint8_t *flashingColor(uint8_t color);
 };
 
+static_assert(colors::COUNT <= 8, "Color names have to fit into three bits");
+// Per head: two bytes and the color switching animation. Every byte here costs
+// MAX_NUM_SIGNAL_HEADS bytes of RAM, see the signal bank in main.cpp.
+#ifdef ANIMATION_EASING
+static_assert(sizeof(SignalHead) <= 9, "SignalHead got larger");
+#else
+static_assert(sizeof(SignalHead) <= 17, "SignalHead got larger");
+#endif
+
 inline void SignalHead::setFlashing(bool flashing) {
-    isFlashing = flashing;
+    if (isFlashing != flashing) {
+        if (!flashing) {
+            finishingFlash = true;
+        }
+        isFlashing = flashing;
+        startAnimationTimer();
+    }
+}
+
+inline void SignalHead::setAspect(colors::ColorName color, bool flashing) {
+    setColor(color);
+    setFlashing(flashing);
 }
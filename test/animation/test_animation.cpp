@@ -0,0 +1,200 @@
+#include <animation.h>
+#include <signalanimations.h>
+#include <configuration.h>
+#include <unity.h>
+
+#include <stdlib.h>
+
+
+// AnimationPlayer as it was before stepping, dividing on every frame
+class ReferencePlayer {
+    uint8_t phaseTimestep = 0;
+    uint8_t phaseIndex;
+
+    static const uint8_t *select(const uint8_t *a, const uint8_t *b, uint8_t index) {
+        switch (index) {
+            case 0: return a;
+            case 1: return b;
+            default: return (const uint8_t*) &colors::outputColorValues[index-2];
+        }
+    }
+
+    static uint8_t blend(uint8_t start, uint8_t end, uint8_t alpha, uint8_t alphaScale) {
+        return uint8_t(int16_t(alpha) * int16_t(end - start) / int16_t(alphaScale)) + start;
+    }
+
+public:
+    ReferencePlayer(uint8_t initialAnimation) : phaseIndex(initialAnimation) {}
+
+    void updateColor(const uint8_t *a, const uint8_t *b, uint8_t *out) {
+        const AnimationPhase *currentPhase = &animations[phaseIndex];
+        const uint8_t phaseLength = currentPhase->length;
+
+        const uint8_t *inputStart = select(a, b, (currentPhase->flags >> 4) & 0x7);
+        const uint8_t *inputEnd = select(a, b, currentPhase->flags & 0x7);
+
+        for (int i = 0; i < 3; i++) {
+            out[i] = blend(inputStart[i], inputEnd[i], phaseTimestep, phaseLength);
+        }
+
+        phaseTimestep += 1;
+        if (phaseTimestep >= phaseLength) {
+            phaseTimestep = 0;
+            phaseIndex = currentPhase->next;
+        }
+    }
+};
+
+void randomColor(uint8_t *color) {
+    for (int i = 0; i < 3; i++) {
+        color[i] = rand() & 0xFF;
+    }
+}
+
+void assertPhase(uint8_t index, uint8_t length, uint8_t flags, uint8_t next) {
+    TEST_ASSERT_EQUAL_UINT8(animations[index].length, length);
+    TEST_ASSERT_EQUAL_HEX8(animations[index].flags, flags);
+    TEST_ASSERT_EQUAL_UINT8(animations[index].next, next);
+}
+
+void testCompiledTable() {
+    // Same as the table that used to be written by hand, with the jump resolved. Flashing
+    // fades to B instead of the off color since all heads share it.
+    const uint8_t flashing = ANIMATION_START_FLASHING;
+    assertPhase(flashing + 0, 2, 0x80, flashing + 1);
+    assertPhase(flashing + 1, 20, 0x01, flashing + 2);
+    assertPhase(flashing + 2, 4, 0x11, flashing + 3);
+    assertPhase(flashing + 3, 20, 0x10, flashing + 0);
+
+    const uint8_t direct = ANIMATION_START_SWITCH_DIRECT;
+    assertPhase(direct + 0, 10, 0x06, direct + 1);
+    assertPhase(direct + 1, 10, 0x61, direct + 2);
+    assertPhase(direct + 2, animation::MAX_PHASE_LENGTH, 0x91, direct + 2);
+
+    const uint8_t red = ANIMATION_START_SWITCH_INTERMEDIATE_RED;
+    assertPhase(red + 0, 5, 0x06, red + 1);
+    assertPhase(red + 1, 5, 0x62, red + 2);
+    assertPhase(red + 2, 1, 0x22, red + 3);
+    assertPhase(red + 3, 5, 0x26, red + 4);
+    assertPhase(red + 4, 5, 0x61, red + 5);
+    assertPhase(red + 5, animation::MAX_PHASE_LENGTH, 0x91, red + 5);
+
+    assertPhase(ANIMATION_SWITCH_DONE, animation::MAX_PHASE_LENGTH, 0x91, ANIMATION_SWITCH_DONE);
+}
+
+void testStepperMatchesDivision() {
+    PhaseStepper stepper;
+    for (int steps = 1; steps <= 127; steps++) {
+        for (int target = 0; target <= 255; target++) {
+            stepper.reset(target, steps, 0);
+            for (int t = 0; t < steps; t++) {
+                if (stepper.value != t * target / steps) {
+                    TEST_FAIL_MESSAGE("Stepped value differs from division");
+                }
+                stepper.step(steps);
+            }
+        }
+    }
+}
+
+void testStepperResetDuringPhase() {
+    PhaseStepper stepper;
+    for (int steps = 1; steps <= 127; steps++) {
+        for (int target = 0; target <= 255; target += 5) {
+            for (int start = 0; start < steps; start++) {
+                stepper.reset(target, steps, start);
+                for (int t = start; t < steps; t++) {
+                    if (stepper.value != t * target / steps) {
+                        TEST_FAIL_MESSAGE("Stepped value differs from division after reset");
+                    }
+                    stepper.step(steps);
+                }
+            }
+        }
+    }
+}
+
+#ifndef ANIMATION_EASING
+void comparePlayers(uint8_t animation, bool changePaletteDuringPhase) {
+    AnimationPlayer player(animation);
+    ReferencePlayer reference(animation);
+
+    uint8_t a[3], b[3];
+    randomColor(a);
+    randomColor(b);
+    // Longer than any animation, to also cover the infinite last phase wrapping around
+    for (int frame = 0; frame < 600; frame++) {
+        // Like programming a color CV; a and b only change with a new animation
+        if (changePaletteDuringPhase && rand() % 4 == 0) {
+            randomColor((uint8_t *) &colors::colorValues[colors::UNDEFINED]);
+            colors::updateOutputColors();
+        }
+
+        uint8_t actual[3], expected[3];
+        player.updateColor(a, b, actual);
+        reference.updateColor(a, b, expected);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, actual, 3);
+    }
+}
+
+void testBitIdenticalToDivision() {
+    for (int run = 0; run < 200; run++) {
+        comparePlayers(ANIMATION_START_FLASHING, false);
+        comparePlayers(ANIMATION_START_SWITCH_DIRECT, false);
+        comparePlayers(ANIMATION_START_SWITCH_INTERMEDIATE_RED, false);
+    }
+}
+
+void testBitIdenticalWithChangingPalette() {
+    for (int run = 0; run < 200; run++) {
+        comparePlayers(ANIMATION_START_FLASHING, true);
+        comparePlayers(ANIMATION_START_SWITCH_DIRECT, true);
+        comparePlayers(ANIMATION_START_SWITCH_INTERMEDIATE_RED, true);
+    }
+}
+#else
+void testEasing() {
+    // First half fades from a to black, the second from black to b
+    AnimationPlayer player(ANIMATION_START_SWITCH_DIRECT);
+    const uint8_t a[3] = { 200, 200, 200 };
+    const uint8_t b[3] = { 0, 200, 0 };
+
+    uint8_t frames[20][3];
+    for (int i = 0; i < 20; i++) {
+        player.updateColor(a, b, frames[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(a, frames[0], 3);
+    // Starts slower than linear, 200 - 200/10
+    TEST_ASSERT_GREATER_THAN(180, frames[1][0]);
+    for (int i = 1; i < 10; i++) {
+        TEST_ASSERT_LESS_OR_EQUAL(frames[i-1][0], frames[i][0]);
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, frames[10][1]);
+    for (int i = 11; i < 20; i++) {
+        TEST_ASSERT_GREATER_OR_EQUAL(frames[i-1][1], frames[i][1]);
+    }
+
+    uint8_t last[3];
+    player.updateColor(a, b, last);
+    TEST_ASSERT_TRUE(player.isComplete());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(b, last, 3);
+}
+#endif
+
+int main() {
+    srand(1);
+    config::values.brightness = config::BRIGHTNESS_MAX;
+    colors::restoreDefaultColorsToEeprom();
+
+    UNITY_BEGIN();
+    RUN_TEST(testCompiledTable);
+    RUN_TEST(testStepperMatchesDivision);
+    RUN_TEST(testStepperResetDuringPhase);
+#ifndef ANIMATION_EASING
+    RUN_TEST(testBitIdenticalToDivision);
+    RUN_TEST(testBitIdenticalWithChangingPalette);
+#else
+    RUN_TEST(testEasing);
+#endif
+    UNITY_END();
+}
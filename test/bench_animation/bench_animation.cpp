@@ -0,0 +1,118 @@
+#include <animation.h>
+#include <signalanimations.h>
+#include <unity.h>
+
+#include <chrono>
+#include <stdio.h>
+
+// Compares the stepping AnimationPlayer with blending by division on every frame. The host
+// divides much faster than the ATtiny, which has no divide (or multiply) instruction, so
+// the difference here is a lower bound.
+
+const int FRAMES = 20000000;
+
+// AnimationPlayer as it was before stepping
+class DividingPlayer {
+    uint8_t phaseTimestep = 0;
+    uint8_t phaseIndex;
+
+    static const uint8_t *select(const uint8_t *a, const uint8_t *b, uint8_t index) {
+        switch (index) {
+            case 0: return a;
+            case 1: return b;
+            default: return (const uint8_t*) &colors::outputColorValues[index-2];
+        }
+    }
+
+    static uint8_t blend(uint8_t start, uint8_t end, uint8_t alpha, uint8_t alphaScale) {
+        return uint8_t(int16_t(alpha) * int16_t(end - start) / int16_t(alphaScale)) + start;
+    }
+
+public:
+    DividingPlayer(uint8_t initialAnimation) : phaseIndex(initialAnimation) {}
+
+    void setAnimation(uint8_t index) {
+        phaseTimestep = 0;
+        phaseIndex = index;
+    }
+
+    // Phases started so far; the stepping player divides once per channel for each
+    uint32_t phasesStarted = 0;
+
+    // Not inlined, like AnimationPlayer::updateColor which lives in its own file
+    __attribute__((noinline)) void updateColor(const uint8_t *a, const uint8_t *b, uint8_t *out) {
+        const AnimationPhase *currentPhase = &animations[phaseIndex];
+        const uint8_t phaseLength = currentPhase->length;
+
+        const uint8_t *inputStart = select(a, b, (currentPhase->flags >> 4) & 0x7);
+        const uint8_t *inputEnd = select(a, b, currentPhase->flags & 0x7);
+
+        for (int i = 0; i < 3; i++) {
+            out[i] = blend(inputStart[i], inputEnd[i], phaseTimestep, phaseLength);
+        }
+        if (phaseTimestep == 0) {
+            phasesStarted++;
+        }
+
+        phaseTimestep += 1;
+        if (phaseTimestep >= phaseLength) {
+            phaseTimestep = 0;
+            phaseIndex = currentPhase->next;
+        }
+    }
+};
+
+// Runs the animation for FRAMES frames, restarting it regularly, and returns nanoseconds per
+// frame.
+template<typename Player>
+double run(Player &player, uint8_t animation) {
+    const uint8_t a[3] = { 255, 40, 0 };
+    const uint8_t b[3] = { 10, 200, 96 };
+    uint8_t out[3];
+    uint32_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        player.updateColor(a, b, out);
+        checksum += out[0] + out[1] + out[2];
+        // The color switch ends in an infinite phase; start over to keep blending
+        if ((frame & 63) == 63 && animation != ANIMATION_START_FLASHING) {
+            player.setAnimation(animation);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // Keeps the loop from getting optimized away
+    TEST_ASSERT_NOT_EQUAL(0, checksum);
+    return std::chrono::duration<double, std::nano>(end - start).count() / FRAMES;
+}
+
+void benchmark(const char *name, uint8_t animation) {
+    DividingPlayer dividingPlayer(animation);
+    AnimationPlayer steppingPlayer(animation);
+    double dividing = run(dividingPlayer, animation);
+    double stepping = run(steppingPlayer, animation);
+
+    // Both walk through the same phases. Divisions are what the ATtiny is slowest at, so
+    // their count per frame is the better measure for it than the time on the host.
+    double steppingDivisions = 3.0 * dividingPlayer.phasesStarted / FRAMES;
+    printf("%-24s dividing %6.2f ns/frame, 3.00 divisions/frame; stepping %6.2f ns/frame, %4.2f divisions/frame\n",
+        name, dividing, stepping, steppingDivisions);
+}
+
+void benchmarkFlashing() {
+    benchmark("Flashing", ANIMATION_START_FLASHING);
+}
+
+void benchmarkColorSwitch() {
+    benchmark("Color switch", ANIMATION_START_SWITCH_INTERMEDIATE_RED);
+}
+
+int main() {
+    colors::restoreDefaultColorsToEeprom();
+
+    UNITY_BEGIN();
+    RUN_TEST(benchmarkFlashing);
+    RUN_TEST(benchmarkColorSwitch);
+    UNITY_END();
+}
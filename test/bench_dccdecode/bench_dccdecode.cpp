@@ -0,0 +1,196 @@
+#include <dccdecode.h>
+#include <dccencode.h>
+#include <unity.h>
+
+#include <chrono>
+#include <stdio.h>
+
+// Measures how fast the decoder gets through realistic DCC traffic.
+
+// Packets generated per traffic pattern; the stream is replayed to get to the total count.
+const uint32_t GENERATED_PACKETS = 200000;
+const int REPETITIONS = 10;
+
+struct Result {
+    uint32_t packetsReceived;
+    double seconds;
+};
+
+Result run(const dccencode::BitStream &stream, void (*receivedBit)(bool), int repetitions = REPETITIONS) {
+    dccdecode::Message message;
+    Result result = { 0, 0 };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int repetition = 0; repetition < repetitions; repetition++) {
+        for (size_t i = 0; i < stream.size(); i++) {
+            receivedBit(stream.bits[i]);
+            // Like the main loop, check for messages regularly. No packet is shorter than 32
+            // bits, so the queue never overflows.
+            if ((i & 31) == 0 && dccdecode::hasNewMessage()) {
+                while (dccdecode::popMessage(message)) {
+                    result.packetsReceived++;
+                }
+            }
+        }
+    }
+    while (dccdecode::popMessage(message)) {
+        result.packetsReceived++;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    return result;
+}
+
+void benchmarkTraffic(const char *name, const dccencode::TrafficOptions &options) {
+    dccencode::TrafficGenerator generator(options);
+    dccencode::BitStream stream;
+    for (uint32_t i = 0; i < GENERATED_PACKETS; i++) {
+        generator.addPacket(stream);
+    }
+
+    double packetsSent = double(GENERATED_PACKETS) * REPETITIONS;
+    double bitsSent = double(stream.size()) * REPETITIONS;
+    uint8_t overrunsBefore = dccdecode::getOverrunCount();
+
+    Result result = run(stream, dccdecode::receivedBit);
+
+    printf("%-24s %7.2f Mpackets/s %8.2f Mbits/s %6.2f ns/bit, drop rate %6.3f%% (%u bit errors in %u packets)\n",
+        name,
+        packetsSent / result.seconds / 1e6,
+        bitsSent / result.seconds / 1e6,
+        result.seconds * 1e9 / bitsSent,
+        100.0 * (packetsSent - result.packetsReceived) / packetsSent,
+        generator.bitErrors * REPETITIONS,
+        generator.packetsWithErrors * REPETITIONS);
+
+    TEST_ASSERT_EQUAL_MESSAGE(dccdecode::getOverrunCount(), overrunsBefore, "No packets dropped by the queue");
+    if (options.bitErrorsPerMillion == 0) {
+        TEST_ASSERT_EQUAL_MESSAGE(result.packetsReceived, uint32_t(packetsSent), "All packets received");
+    }
+}
+
+void benchmarkMostlyIdle() {
+    dccencode::TrafficOptions options;
+    options.idlePercent = 80;
+    benchmarkTraffic("mostly idle", options);
+}
+
+void benchmarkBusyAccessories() {
+    dccencode::TrafficOptions options;
+    options.idlePercent = 20;
+    benchmarkTraffic("busy accessories", options);
+}
+
+void benchmarkLongPreamble() {
+    dccencode::TrafficOptions options;
+    options.preambleLength = 20;
+    benchmarkTraffic("long preamble", options);
+}
+
+void benchmarkBitErrors() {
+    dccencode::TrafficOptions options;
+    options.bitErrorsPerMillion = 1000;
+    benchmarkTraffic("0.1% bit errors", options);
+}
+
+void benchmarkDecoderCores() {
+    // Same traffic through both decoder cores
+    dccencode::TrafficOptions options;
+    dccencode::TrafficGenerator generator(options);
+    dccencode::BitStream stream;
+    for (uint32_t i = 0; i < GENERATED_PACKETS; i++) {
+        generator.addPacket(stream);
+    }
+    double bitsSent = double(stream.size()) * REPETITIONS;
+
+    Result switchResult = run(stream, dccdecode::receivedBitSwitchDecoder);
+    printf("%-24s %6.2f ns/bit\n", "switch decoder core", switchResult.seconds * 1e9 / bitsSent);
+    Result tableResult = run(stream, dccdecode::receivedBitTableDecoder);
+    printf("%-24s %6.2f ns/bit\n", "table decoder core", tableResult.seconds * 1e9 / bitsSent);
+
+    TEST_ASSERT_EQUAL_MESSAGE(switchResult.packetsReceived, tableResult.packetsReceived, "Both cores decode the same packets");
+}
+
+void benchmarkPacketFilter() {
+    // Three signal heads among 64 accessory addresses. Kept below the 0xFFFF at which the
+    // counters saturate.
+    const uint32_t packets = 50000;
+    dccencode::TrafficOptions options;
+    options.idlePercent = 60;
+    dccencode::TrafficGenerator generator(options);
+    dccencode::BitStream stream;
+    for (uint32_t i = 0; i < packets; i++) {
+        generator.addPacket(stream);
+    }
+
+    dccdecode::Statistics before = dccdecode::getStatistics();
+    dccdecode::setPacketFilter(10, 9);
+    Result result = run(stream, dccdecode::receivedBit, 1);
+    dccdecode::disablePacketFilter();
+    dccdecode::Statistics after = dccdecode::getStatistics();
+
+    uint16_t delivered = after.deliveredPackets - before.deliveredPackets;
+    uint16_t filtered = after.filteredPackets - before.filteredPackets;
+    printf("%-24s %u delivered, %u filtered (%.1f%% of packets reach the main loop)\n",
+        "packet filter", delivered, filtered, 100.0 * delivered / packets);
+
+    TEST_ASSERT_EQUAL_MESSAGE(result.packetsReceived, delivered, "Delivered packets are the ones received");
+    TEST_ASSERT_EQUAL_MESSAGE(delivered + filtered, packets, "Every packet either delivered or filtered");
+}
+
+void benchmarkEdgeTiming() {
+    // Same traffic, but timestamped edges through receivedEdge() instead of sampled bits
+    dccencode::TrafficOptions options;
+    dccencode::TrafficGenerator generator(options);
+    dccencode::BitStream stream;
+    for (uint32_t i = 0; i < GENERATED_PACKETS; i++) {
+        generator.addPacket(stream);
+    }
+    dccencode::EdgeTrace trace;
+    trace.addBits(stream);
+
+    dccdecode::Message message;
+    uint32_t packetsReceived = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int repetition = 0; repetition < REPETITIONS; repetition++) {
+        for (size_t i = 0; i < trace.size(); i++) {
+            dccdecode::receivedEdge(trace.timestamps[i]);
+            if ((i & 63) == 0) {
+                while (dccdecode::popMessage(message)) {
+                    packetsReceived++;
+                }
+            }
+        }
+    }
+    while (dccdecode::popMessage(message)) {
+        packetsReceived++;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double packetsSent = double(GENERATED_PACKETS) * REPETITIONS;
+    double edges = double(trace.size()) * REPETITIONS;
+    printf("%-24s %7.2f Mpackets/s %6.2f ns/edge, drop rate %6.3f%%\n",
+        "edge timing",
+        packetsSent / seconds / 1e6,
+        seconds * 1e9 / edges,
+        100.0 * (packetsSent - packetsReceived) / packetsSent);
+
+    // The very first edge has no previous one to compare with, so the first packet may be lost
+    TEST_ASSERT_GREATER_OR_EQUAL(uint32_t(packetsSent) - 1, packetsReceived);
+}
+
+int main() {
+    UNITY_BEGIN();
+    // First, while the counters are far from saturating
+    RUN_TEST(benchmarkPacketFilter);
+    RUN_TEST(benchmarkDecoderCores);
+    RUN_TEST(benchmarkMostlyIdle);
+    RUN_TEST(benchmarkBusyAccessories);
+    RUN_TEST(benchmarkLongPreamble);
+    RUN_TEST(benchmarkBitErrors);
+    RUN_TEST(benchmarkEdgeTiming);
+    UNITY_END();
+    return 0;
+}
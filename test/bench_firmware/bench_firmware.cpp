@@ -0,0 +1,174 @@
+#include <main.h>
+#include <hal.h>
+#include <colors.h>
+#include <configuration.h>
+#include <packetcache.h>
+#include <dccencode.h>
+#include <unity.h>
+
+#include <chrono>
+#include <stdio.h>
+
+// Measures the whole firmware, from DCC bits to LED output, on simulated hardware.
+
+const uint32_t GENERATED_PACKETS = 200000;
+// A bit takes at least 116 us, so this is a bit more often than every 20 ms
+const int BITS_PER_ANIMATION_FRAME = 160;
+
+void benchmarkTraffic(const char *name, const dccencode::TrafficOptions &options, uint32_t packets = GENERATED_PACKETS) {
+    dccencode::TrafficGenerator generator(options);
+    dccencode::BitStream stream;
+    for (uint32_t i = 0; i < packets; i++) {
+        generator.addPacket(stream);
+    }
+
+    hal::host::State &device = hal::host::state;
+    const uint32_t transmissionsBefore = device.ledTransmissions;
+    const uint32_t ledBytesBefore = device.ledBytesSent;
+    uint32_t frames = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < stream.size(); i++) {
+        dccdecode::receivedBit(stream.bits[i]);
+        if (i % BITS_PER_ANIMATION_FRAME == 0 && hal::host::fireTimer1()) {
+            frames++;
+        }
+        // Like on the device, where the main loop runs between interrupts
+        if ((i & 31) == 0) {
+            while (dccdecode::hasNewMessage()) {
+                loop();
+            }
+            loop();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    printf("%-24s %6.2f Mpackets/s %6.1f ns/packet, %u animation frames, %u LED transmissions, %u LED bytes\n",
+        name,
+        packets / seconds / 1e6,
+        seconds * 1e9 / packets,
+        frames,
+        device.ledTransmissions - transmissionsBefore,
+        device.ledBytesSent - ledBytesBefore);
+}
+
+dccencode::TrafficOptions accessoryTraffic() {
+    // POM and service mode packets would change the configuration
+    dccencode::TrafficOptions options;
+    options.accessoryPomWeight = 0;
+    options.serviceModeWeight = 0;
+    return options;
+}
+
+void benchmarkMostlyOtherDecoders() {
+    dccencode::TrafficOptions options = accessoryTraffic();
+    options.firstOutputAddress = 1;
+    options.outputAddressCount = 256;
+    benchmarkTraffic("Mostly other decoders", options);
+}
+
+void benchmarkOnlyOurAddresses() {
+    dccencode::TrafficOptions options = accessoryTraffic();
+    options.firstOutputAddress = 1;
+    options.outputAddressCount = config::values.activeSignalHeads * 3;
+    benchmarkTraffic("Only our addresses", options);
+}
+
+// Command stations send every accessory packet several times; most of the copies should not
+// get further than the packet cache.
+void benchmarkRepeatedCommands() {
+    dccencode::TrafficOptions options = accessoryTraffic();
+    options.firstOutputAddress = 1;
+    options.outputAddressCount = config::values.activeSignalHeads * 3;
+    options.repeatCount = 4;
+    // Few enough packets that the counters don't saturate
+    packetcache::resetStatistics();
+    benchmarkTraffic("Commands repeated 4x", options, 50000);
+    const packetcache::Statistics statistics = packetcache::getStatistics();
+
+    const uint32_t checked = statistics.checkedPackets;
+    const uint32_t dropped = statistics.droppedRepeats;
+    printf("%-24s %u accessory commands, %u handled, %u dropped as repeats (%.1f%%)\n",
+        "", checked, checked - dropped, dropped, 100.0 * dropped / checked);
+    TEST_ASSERT_GREATER_THAN_MESSAGE(checked / 2, dropped, "Most repeats dropped");
+}
+
+// Cost of parseNewMessage() for a repeat, and for the same packet when it has to be decoded
+void benchmarkRepeatCost() {
+    const uint32_t iterations = 1000000;
+    dccdecode::Message message;
+    message.length = 3;
+    message.data[0] = 0x81;
+    message.data[1] = 0xF0; // Output 1, off; doesn't change anything
+    message.data[2] = message.data[0] ^ message.data[1];
+
+    parseNewMessage(message);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        parseNewMessage(message);
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        packetcache::flush();
+        parseNewMessage(message);
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("%-24s %6.1f ns/packet as a repeat, %6.1f ns/packet decoded (host time, flush included)\n",
+        "Repeat cost",
+        std::chrono::duration<double>(middle - start).count() * 1e9 / iterations,
+        std::chrono::duration<double>(end - middle).count() * 1e9 / iterations);
+}
+
+// Time the main loop spends waiting for the EEPROM, with the write queue and as it would
+// have been with synchronous writes
+void benchmarkEepromBlocking() {
+    hal::host::State &device = hal::host::state;
+    struct Scenario {
+        const char *name;
+        uint16_t cv;
+        uint8_t value;
+        uint8_t restore;
+    } scenarios[] = {
+        { "Single CV write", config::CV_INDEX_BRIGHTNESS, 50, 100 },
+        { "Factory reset", 8, 8, 0 },
+    };
+
+    for (const Scenario &scenario : scenarios) {
+        if (scenario.cv == 8) {
+            // Make the reset change every color
+            for (uint8_t i = 0; i < 3 * colors::COUNT; i++) {
+                writeCvValue(48 + i, 1);
+            }
+        }
+        hal::host::advanceTime(1000000);
+
+        const uint32_t blockedBefore = device.eepromBlockedMicroseconds;
+        const uint32_t synchronousBefore = device.eepromSynchronousMicroseconds;
+        writeCvValue(scenario.cv, scenario.value);
+        printf("%-24s blocked %6.1f ms, synchronous writes would have blocked %6.1f ms\n",
+            scenario.name,
+            (device.eepromBlockedMicroseconds - blockedBefore) / 1000.0,
+            (device.eepromSynchronousMicroseconds - synchronousBefore) / 1000.0);
+
+        if (scenario.cv != 8) {
+            writeCvValue(scenario.cv, scenario.restore);
+        }
+        hal::host::advanceTime(1000000);
+    }
+}
+
+int main() {
+    setup();
+    // Factory settings, with all heads in use
+    writeCvValue(8, 8);
+    writeCvValue(config::CV_INDEX_NUM_SIGNAL_HEADS, config::MAX_NUM_SIGNAL_HEADS);
+
+    UNITY_BEGIN();
+    RUN_TEST(benchmarkMostlyOtherDecoders);
+    RUN_TEST(benchmarkOnlyOurAddresses);
+    RUN_TEST(benchmarkRepeatedCommands);
+    RUN_TEST(benchmarkRepeatCost);
+    RUN_TEST(benchmarkEepromBlocking);
+    UNITY_END();
+}
@@ -0,0 +1,78 @@
+#include <signalbank.h>
+#include <configuration.h>
+#include <unity.h>
+
+#include <chrono>
+#include <stdio.h>
+
+// Measures the cost of calculating one frame depending on the size of the signal bank.
+
+const int FRAMES = 200000;
+
+// Every head flashing, which changes every LED in most frames, and every head showing a
+// steady color, where nothing gets sent. The latter happens for heads that are done while
+// others still animate.
+template<uint8_t Heads, uint8_t LedsPerHead>
+void benchmarkBank() {
+    uint8_t mapping[Heads * LedsPerHead];
+    for (uint8_t led = 0; led < sizeof(mapping); led++) {
+        mapping[led] = led / LedsPerHead;
+    }
+    SignalBank<Heads, LedsPerHead> bank(mapping);
+
+    uint32_t bytesSent = 0;
+    for (uint8_t i = 0; i < Heads; i++) {
+        bank.heads[i].setFlashing(true);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        bytesSent += bank.update(Heads);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double flashing = std::chrono::duration<double, std::nano>(end - start).count() / FRAMES;
+
+    for (uint8_t i = 0; i < Heads; i++) {
+        bank.heads[i].setFlashing(false);
+    }
+    while (SignalHead::isAnimationTimerRunning()) {
+        bank.update(Heads);
+    }
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        bytesSent += bank.update(Heads);
+    }
+    end = std::chrono::steady_clock::now();
+    double steady = std::chrono::duration<double, std::nano>(end - start).count() / FRAMES;
+
+    TEST_ASSERT_NOT_EQUAL(0, bytesSent);
+    printf("%2u heads x %u LEDs: flashing %7.1f ns/frame (%5.1f ns/head), steady %6.1f ns/frame, %3u bytes RAM on the host\n",
+        Heads, LedsPerHead, flashing, flashing / Heads, steady, unsigned(sizeof(bank)));
+}
+
+void benchmarkOneLedPerHead() {
+    benchmarkBank<1, 1>();
+    benchmarkBank<2, 1>();
+    benchmarkBank<3, 1>();
+    benchmarkBank<4, 1>();
+    benchmarkBank<8, 1>();
+    benchmarkBank<12, 1>();
+    benchmarkBank<16, 1>();
+}
+
+void benchmarkSeveralLedsPerHead() {
+    benchmarkBank<3, 2>();
+    benchmarkBank<8, 2>();
+    benchmarkBank<16, 2>();
+    benchmarkBank<16, 4>();
+}
+
+int main() {
+    config::values.brightness = config::BRIGHTNESS_MAX;
+    config::values.colorOrder = config::Configuration::COLOR_ORDER_RGB;
+    colors::restoreDefaultColorsToEeprom();
+
+    UNITY_BEGIN();
+    RUN_TEST(benchmarkOneLedPerHead);
+    RUN_TEST(benchmarkSeveralLedsPerHead);
+    UNITY_END();
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+// Operations per 1000 frames in bench_signalhead, as of the last change that was allowed to
+// cost more. The benchmark fails if any of them grows by more than REGRESSION_PERCENT. To
+// update it, copy the "baseline" lines from the benchmark's output. The counts are for the
+// default build; with ANIMATION_EASING they only get printed.
+
+const uint8_t REGRESSION_PERCENT = 5;
+
+struct BaselineEntry {
+    const char *name;
+    uint32_t playerUpdates;
+    uint32_t divisions;
+    uint32_t multiplications;
+};
+
+const BaselineEntry baseline[] = {
+    { "Steady", 1000, 47, 0 },
+    { "Direct switch", 1000, 449, 0 },
+    { "Switch via red", 1000, 899, 0 },
+    { "Flashing", 2000, 568, 0 },
+    { "Flashing during switch", 1475, 2983, 1636 },
+    { "Animation loop, 1 head", 1049, 1968, 1003 },
+    { "Animation loop, 2 heads", 2243, 1921, 829 },
+    { "Animation loop, 3 heads", 3297, 2136, 983 },
+};
@@ -0,0 +1,150 @@
+#include <main.h>
+#include <hal.h>
+#include <configuration.h>
+#include <signalhead.h>
+#include <signalanimations.h>
+#include <dccencode.h>
+#include <unity.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "baseline.h"
+
+// Measures what a frame costs for each state a signal head can be in, and for the firmware's
+// animation loop. Time on the host says little about the ATtiny, so the operation counts from
+// animation::operationCounts are what gets compared with baseline.h.
+
+const int FRAMES = 1000000;
+// Long enough for any color switch to finish
+const int FRAMES_PER_COMMAND = 40;
+
+struct Measurement {
+    double nanoseconds;
+    animation::OperationCounts operations;
+};
+
+void report(const char *name, const Measurement &measurement) {
+    const animation::OperationCounts &operations = measurement.operations;
+    const uint32_t playerUpdates = uint64_t(operations.playerUpdates) * 1000 / FRAMES;
+    const uint32_t divisions = uint64_t(operations.divisions) * 1000 / FRAMES;
+    const uint32_t multiplications = uint64_t(operations.multiplications) * 1000 / FRAMES;
+    printf("%-28s %7.1f ns/frame, per frame: %5.2f player updates, %5.2f divisions, %5.2f multiplications\n",
+        name, measurement.nanoseconds, playerUpdates / 1000.0, divisions / 1000.0, multiplications / 1000.0);
+    printf("baseline:     { \"%s\", %u, %u, %u },\n", name, playerUpdates, divisions, multiplications);
+
+#ifndef ANIMATION_EASING
+    const BaselineEntry *entry = nullptr;
+    for (const BaselineEntry &candidate: baseline) {
+        if (strcmp(candidate.name, name) == 0) {
+            entry = &candidate;
+        }
+    }
+    if (entry == nullptr) {
+        TEST_FAIL_MESSAGE("Not in baseline.h yet");
+        return;
+    }
+    const uint32_t factor = 100 + REGRESSION_PERCENT;
+    TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(entry->playerUpdates * factor, playerUpdates * 100, "Player updates regressed");
+    TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(entry->divisions * factor, divisions * 100, "Divisions regressed");
+    TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(entry->multiplications * factor, multiplications * 100, "Multiplications regressed");
+#endif
+}
+
+// What a single head does in each frame, with a command every FRAMES_PER_COMMAND frames
+template<typename Command>
+Measurement measureHead(bool flashing, Command command) {
+    SignalHead head;
+    head.setFlashing(flashing);
+    uint8_t color[3] = {};
+    uint32_t checksum = 0;
+
+    animation::operationCounts = animation::OperationCounts();
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        if (frame % FRAMES_PER_COMMAND == 0) {
+            command(head, frame / FRAMES_PER_COMMAND);
+        }
+        SignalHead::updateFlashingPhase();
+        head.updateColor(color);
+        checksum += color[0] + color[1] + color[2];
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // Keeps the loop from getting optimized away
+    TEST_ASSERT_NOT_EQUAL(0, checksum);
+    head.setFlashing(false);
+    return { std::chrono::duration<double, std::nano>(end - start).count() / FRAMES, animation::operationCounts };
+}
+
+void steady(SignalHead &, int) {}
+
+// Red is on one side of each switch, so there is no intermediate red
+void switchDirect(SignalHead &head, int command) {
+    head.setColor(command % 2 ? colors::GREEN : colors::RED);
+}
+
+void switchViaRed(SignalHead &head, int command) {
+    head.setColor(command % 2 ? colors::GREEN : colors::YELLOW);
+}
+
+void benchmarkHeadStates() {
+    // Starts red, so this is red from the beginning
+    report("Steady", measureHead(false, steady));
+    report("Direct switch", measureHead(false, switchDirect));
+    report("Switch via red", measureHead(false, switchViaRed));
+    report("Flashing", measureHead(true, steady));
+    report("Flashing during switch", measureHead(true, switchViaRed));
+}
+
+dccdecode::Message message(const dccencode::Packet &packet) {
+    dccdecode::Message message;
+    message.length = packet.length + 1;
+    uint8_t checksum = 0;
+    for (uint8_t i = 0; i < packet.length; i++) {
+        message.data[i] = packet.data[i];
+        checksum ^= packet.data[i];
+    }
+    message.data[packet.length] = checksum;
+    return message;
+}
+
+// The firmware's animation loop, with the heads going through all aspects one after another
+void benchmarkAnimationLoop() {
+    for (uint8_t heads = 1; heads <= config::MAX_NUM_SIGNAL_HEADS; heads++) {
+        writeCvValue(config::CV_INDEX_NUM_SIGNAL_HEADS, heads);
+        hal::host::State &device = hal::host::state;
+        const uint32_t ledBytesBefore = device.ledBytesSent;
+
+        animation::operationCounts = animation::OperationCounts();
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < FRAMES; frame++) {
+            if (frame % FRAMES_PER_COMMAND == 0) {
+                const int command = frame / FRAMES_PER_COMMAND;
+                const uint8_t aspect = (command / heads) % config::ASPECT_COUNT;
+                parseNewMessage(message(dccencode::extendedAccessoryPacket(config::values.address + command % heads, aspect)));
+            }
+            hal::host::fireTimer1();
+            updateAnimation();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        TEST_ASSERT_NOT_EQUAL(device.ledBytesSent, ledBytesBefore);
+        char name[32];
+        snprintf(name, sizeof(name), "Animation loop, %u head%s", heads, heads == 1 ? "" : "s");
+        report(name, { std::chrono::duration<double, std::nano>(end - start).count() / FRAMES, animation::operationCounts });
+    }
+}
+
+int main() {
+    setup();
+    writeCvValue(8, 8);
+    config::values.brightness = config::BRIGHTNESS_MAX;
+    colors::updateOutputColors();
+
+    UNITY_BEGIN();
+    RUN_TEST(benchmarkHeadStates);
+    RUN_TEST(benchmarkAnimationLoop);
+    UNITY_END();
+}
@@ -0,0 +1,231 @@
+#include <main.h>
+#include <hal.h>
+#include <colors.h>
+#include <configuration.h>
+#include <cvtable.h>
+#include <dccdecode.h>
+#include <eepromlayout.h>
+#include <unity.h>
+
+// The CV table has to behave exactly like the switch statements it replaced, which are below,
+// together with the diagnostic and aspect CVs added since.
+
+const uint16_t CV_COUNT = 1024;
+const uint8_t testValues[] = { 0, 1, 2, 3, 7, 8, 100, 127, 128, config::DEFAULT_CONFIGURATION, config::LED_MAPPING_DARK, 0xFF };
+
+bool isMappingCv(uint16_t cv) {
+    return cv >= config::CV_INDEX_LED_MAPPING_BASE && cv < config::CV_INDEX_LED_MAPPING_BASE + config::MAX_NUM_LEDS;
+}
+
+bool isColorCv(uint16_t cv) {
+    return cv >= config::CV_INDEX_COLOR_BASE && cv < config::CV_INDEX_COLOR_BASE + 3 * colors::COUNT;
+}
+
+bool isAspectCv(uint16_t cv) {
+    return cv >= config::CV_INDEX_ASPECT_BASE && cv < config::CV_INDEX_ASPECT_BASE + config::ASPECT_COUNT;
+}
+
+bool isStatisticsCv(uint16_t cv) {
+    return cv >= config::CV_INDEX_STATISTICS_BASE && cv < config::CV_INDEX_STATISTICS_BASE + 14;
+}
+
+uint16_t referenceRead(uint16_t cv) {
+    if (isColorCv(cv)) {
+        return ((uint8_t *) colors::colorValues)[cv - config::CV_INDEX_COLOR_BASE];
+    }
+    if (isMappingCv(cv)) {
+        return config::values.ledMapping[cv - config::CV_INDEX_LED_MAPPING_BASE];
+    }
+    if (isAspectCv(cv)) {
+        return config::values.aspects[cv - config::CV_INDEX_ASPECT_BASE];
+    }
+    if (isStatisticsCv(cv)) {
+        const dccdecode::Statistics statistics = dccdecode::getStatistics();
+        const uint16_t counters[] = {
+            statistics.deliveredPackets, statistics.filteredPackets, statistics.addressedPackets,
+            statistics.preambleRestarts, statistics.xorErrors, statistics.lengthOverflows,
+            statistics.queueOverruns
+        };
+        const uint8_t index = cv - config::CV_INDEX_STATISTICS_BASE;
+        return (index & 1) ? counters[index / 2] >> 8 : counters[index / 2] & 0xFF;
+    }
+    switch (cv) {
+        case 1:
+        case 18: return config::values.address & 0xFF;
+        case 7: return 1;
+        case 8: return 0x0D;
+        case 9:
+        case 17: return config::values.address >> 8;
+        case 29: return config::DEFAULT_CONFIGURATION;
+        case 31: return config::values.extendedRangeHigh;
+        case 32: return config::values.extendedRangeLow;
+        case config::CV_INDEX_BRIGHTNESS: return config::values.brightness;
+        case config::CV_INDEX_COLOR_ORDER: return config::values.colorOrder;
+        case config::CV_INDEX_NUM_SIGNAL_HEADS: return config::values.activeSignalHeads;
+        case config::CV_INDEX_WORKAROUNDS: return config::values.workarounds;
+        default: return 0xFFFF;
+    }
+}
+
+// Whether the write gets accepted, and what the CV reads afterwards if it does
+bool referenceWrite(uint16_t cv, uint8_t value, uint8_t &readBack) {
+    readBack = value;
+    if (isColorCv(cv)) {
+        return true;
+    }
+    if (isMappingCv(cv)) {
+        return value < config::MAX_NUM_SIGNAL_HEADS || value == config::LED_MAPPING_DARK;
+    }
+    if (isAspectCv(cv)) {
+        readBack = value & config::ASPECT_VALID_BITS;
+        return true;
+    }
+    if (isStatisticsCv(cv)) {
+        // Reset
+        return value == 0;
+    }
+    switch (cv) {
+        case 1:
+        case 9:
+        case 17:
+        case 18:
+        case 31:
+        case 32:
+        case config::CV_INDEX_BRIGHTNESS:
+        case config::CV_INDEX_COLOR_ORDER:
+            return true;
+        case 29:
+            return value == config::DEFAULT_CONFIGURATION;
+        case config::CV_INDEX_NUM_SIGNAL_HEADS:
+            readBack = value <= config::MAX_NUM_SIGNAL_HEADS ? value : config::MAX_NUM_SIGNAL_HEADS;
+            return true;
+        case config::CV_INDEX_WORKAROUNDS:
+            readBack = value & config::WORKAROUND_VALID_BITS;
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint8_t referenceWriteMask(uint16_t cv) {
+    if (isAspectCv(cv)) {
+        return config::ASPECT_VALID_BITS;
+    }
+    return cv == config::CV_INDEX_WORKAROUNDS ? config::WORKAROUND_VALID_BITS : 0xFF;
+}
+
+void assertAllCvsMatchReference() {
+    for (uint16_t cv = 0; cv <= CV_COUNT; cv++) {
+        TEST_ASSERT_EQUAL_MESSAGE(getCvValue(cv), referenceRead(cv), "Read");
+    }
+}
+
+void testRead() {
+    assertAllCvsMatchReference();
+    TEST_ASSERT_EQUAL(getCvValue(1), 1);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_COLOR_BASE), 255);
+}
+
+void testWrite() {
+    for (uint16_t cv = 0; cv <= CV_COUNT; cv++) {
+        for (uint8_t value: testValues) {
+            if (cv == 8 && value == 8) {
+                continue; // Factory reset, tested below
+            }
+            const uint16_t before = getCvValue(cv);
+            uint8_t expected;
+            const bool accepted = referenceWrite(cv, value, expected);
+            TEST_ASSERT_EQUAL_MESSAGE(writeCvValue(cv, value), accepted, "Accepted");
+            TEST_ASSERT_EQUAL_MESSAGE(getCvValue(cv), accepted ? expected : before, "Value after write");
+            TEST_ASSERT_EQUAL_MESSAGE(getCvValue(cv), referenceRead(cv), "Stored in the right place");
+        }
+        TEST_ASSERT_EQUAL_MESSAGE(cvtable::writeMask(cv), referenceWriteMask(cv), "Write mask");
+    }
+    assertAllCvsMatchReference();
+}
+
+void testWritesAreStored() {
+    for (uint16_t cv = 0; cv <= CV_COUNT; cv++) {
+        writeCvValue(cv, 2);
+    }
+    uint16_t written[CV_COUNT + 1];
+    for (uint16_t cv = 0; cv <= CV_COUNT; cv++) {
+        written[cv] = getCvValue(cv);
+    }
+    hal::host::advanceTime(1000000);
+
+    config::loadConfiguration();
+    colors::loadColorsFromEeprom();
+    for (uint16_t cv = 0; cv <= CV_COUNT; cv++) {
+        TEST_ASSERT_EQUAL_MESSAGE(getCvValue(cv), written[cv], "Read back from EEPROM");
+    }
+}
+
+void testStatistics() {
+    for (int i = 0; i < 300; i++) {
+        dccdecode::countAddressedPacket();
+    }
+    const uint16_t addressedCv = config::CV_INDEX_STATISTICS_BASE + 2 * 2;
+    TEST_ASSERT_EQUAL(getCvValue(addressedCv), 300 & 0xFF);
+    TEST_ASSERT_EQUAL(getCvValue(addressedCv + 1), 300 >> 8);
+    assertAllCvsMatchReference();
+
+    TEST_ASSERT_FALSE_MESSAGE(writeCvValue(addressedCv, 5), "Read-only");
+    TEST_ASSERT_TRUE_MESSAGE(writeCvValue(config::CV_INDEX_STATISTICS_BASE, 0), "Reset");
+    TEST_ASSERT_EQUAL(getCvValue(addressedCv), 0);
+    TEST_ASSERT_EQUAL(getCvValue(addressedCv + 1), 0);
+}
+
+void testOutputColorsUpdated() {
+    writeCvValue(config::CV_INDEX_COLOR_ORDER, config::Configuration::COLOR_ORDER_RGB);
+    writeCvValue(config::CV_INDEX_BRIGHTNESS, config::BRIGHTNESS_MAX);
+    writeCvValue(config::CV_INDEX_COLOR_BASE + colors::GREEN * 3 + 1, 200);
+    TEST_ASSERT_EQUAL(colors::outputColorValues[colors::GREEN].g, 200);
+    writeCvValue(config::CV_INDEX_BRIGHTNESS, config::BRIGHTNESS_MAX / 2);
+    TEST_ASSERT_EQUAL(colors::outputColorValues[colors::GREEN].g, 100);
+    writeCvValue(config::CV_INDEX_COLOR_ORDER, config::Configuration::COLOR_ORDER_GRB);
+    TEST_ASSERT_EQUAL(colors::outputColorValues[colors::GREEN].r, 100);
+}
+
+void testFactoryReset() {
+    writeCvValue(1, 42);
+    TEST_ASSERT_FALSE(writeCvValue(8, 7));
+    TEST_ASSERT_EQUAL(getCvValue(1), 42);
+
+    TEST_ASSERT_TRUE(writeCvValue(8, 8));
+    TEST_ASSERT_EQUAL(getCvValue(1), 1);
+    TEST_ASSERT_EQUAL(getCvValue(9), 0);
+    TEST_ASSERT_EQUAL(getCvValue(31), 0);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_BRIGHTNESS), 100);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_COLOR_BASE + colors::GREEN * 3 + 1), 255);
+    assertAllCvsMatchReference();
+}
+
+void testInvalidAspectsFallBackToDefaults() {
+    writeCvValue(config::CV_INDEX_ASPECT_BASE + 1, colors::LUNAR);
+    hal::host::advanceTime(1000000);
+    // Bits that no CV write can set, as from a corrupted EEPROM
+    eepromlayout::stored.configuration.aspects[2] = 0x7C;
+    eepromlayout::stored.configuration.aspects[5] = 0xFF;
+
+    config::loadConfiguration();
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_ASPECT_BASE + 1), colors::LUNAR);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_ASPECT_BASE + 2), colors::YELLOW);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_ASPECT_BASE + 5), colors::GREEN | config::ASPECT_BIT_FLASHING);
+    assertAllCvsMatchReference();
+}
+
+int main() {
+    setup();
+    writeCvValue(8, 8);
+
+    UNITY_BEGIN();
+    RUN_TEST(testRead);
+    RUN_TEST(testWrite);
+    RUN_TEST(testWritesAreStored);
+    RUN_TEST(testStatistics);
+    RUN_TEST(testOutputColorsUpdated);
+    RUN_TEST(testFactoryReset);
+    RUN_TEST(testInvalidAspectsFallBackToDefaults);
+    UNITY_END();
+}
@@ -1,79 +1,467 @@
 #include <dccdecode.h>
+#include <dccencode.h>
 #include <unity.h>
 
+// All tests run once for each decoder core
+void (*receivedBit)(bool bitValue) = dccdecode::receivedBitSwitchDecoder;
+
 void testInitial() {
     TEST_ASSERT_FALSE(dccdecode::hasNewMessage());
 }
 
-void writeDccByte(uint8_t aByte) {
-    // Separator
-    dccdecode::receivedBit(false);
-
-    // Data
-    for (int i = 7; i >= 0; i--) {
-        dccdecode::receivedBit(aByte & (1 << i));
-    }
+void send(const dccencode::BitStream &bits) {
+    bits.feed(receivedBit);
 }
 
-void writePreamble(int size=12) {
-    for (int i = 0; i < size; i++) {
-        dccdecode::receivedBit(true);
-    }
-}
+void testShortPreamble() {
+    const uint16_t restartsBefore = dccdecode::getStatistics().preambleRestarts;
+    const uint8_t data[] = { 0xFF, 0x00 };
+    dccencode::BitStream bits;
+    bits.addPacket(data, sizeof(data), 5);
+    send(bits);
 
-void writeTerminator() {
-    dccdecode::receivedBit(true);
+    TEST_ASSERT_FALSE(dccdecode::hasNewMessage());
+    TEST_ASSERT_GREATER_THAN(restartsBefore, dccdecode::getStatistics().preambleRestarts);
 }
 
-void testShortPreamble() {
-    writePreamble(5);
-    writeDccByte(0xFF);
-    writeDccByte(0x00);
-    writeDccByte(0xFF);
-    writeTerminator();
+void testMinimumPreamble() {
+    dccdecode::Message message;
+    const uint8_t data[] = { 0xF0, 0x0F };
 
-    TEST_ASSERT_FALSE(dccdecode::hasNewMessage());
+    // Nine 1s are not enough. Runs first, so there are no 1s left over from other tests.
+    dccencode::BitStream tooShort;
+    tooShort.addPacket(data, sizeof(data), 9);
+    send(tooShort);
+    TEST_ASSERT_FALSE(dccdecode::popMessage(message));
+
+    // Ten 1s are
+    dccencode::BitStream longEnough;
+    longEnough.addPacket(data, sizeof(data), 10);
+    send(longEnough);
+    TEST_ASSERT(dccdecode::popMessage(message));
 }
 
 void testInvalidXor() {
-    writePreamble();
-    writeDccByte(0xFF);
-    writeDccByte(0x00);
-    writeDccByte(0xFE);
-    writeTerminator();
+    dccencode::BitStream bits;
+    bits.addPreamble();
+    bits.addByte(0xFF);
+    bits.addByte(0x00);
+    bits.addByte(0xFE);
+    bits.addPacketEnd();
+    const uint16_t errorsBefore = dccdecode::getStatistics().xorErrors;
+    send(bits);
 
     TEST_ASSERT_FALSE(dccdecode::hasNewMessage());
+    TEST_ASSERT_EQUAL_MESSAGE(dccdecode::getStatistics().xorErrors, errorsBefore + 1, "XOR errors");
 }
 
 void testOverlyLongMessage() {
-    writePreamble();
+    dccencode::BitStream bits;
+    bits.addPreamble();
     for (int i = 0; i < 100; i++)
-        writeDccByte(0x00);
-    writeTerminator();
+        bits.addByte(0x00);
+    bits.addPacketEnd();
+    const uint16_t overflowsBefore = dccdecode::getStatistics().lengthOverflows;
+    send(bits);
 
     TEST_ASSERT_FALSE(dccdecode::hasNewMessage());
+    TEST_ASSERT_EQUAL_MESSAGE(dccdecode::getStatistics().lengthOverflows, overflowsBefore + 1, "Length overflows");
+}
+
+void writeAccessoryPacket(uint8_t first, uint8_t second) {
+    const uint8_t data[] = { first, second };
+    dccencode::BitStream bits;
+    bits.addPacket(data, sizeof(data));
+    send(bits);
 }
 
 void testReceiveMessage() {
-    writePreamble();
-    writeDccByte(0xF0);
-    writeDccByte(0x0F);
-    writeDccByte(0xFF);
-    writeTerminator();
+    writeAccessoryPacket(0xF0, 0x0F);
 
     TEST_ASSERT(dccdecode::hasNewMessage());
-    TEST_ASSERT_EQUAL_MESSAGE(dccdecode::message.length, 3, "Message length");
+    dccdecode::Message message;
+    TEST_ASSERT(dccdecode::popMessage(message));
+    TEST_ASSERT_EQUAL_MESSAGE(message.length, 3, "Message length");
     const uint8_t expected[] = { 0xF0, 0x0F, 0xFF };
-    TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(expected, dccdecode::message.data, sizeof(expected), "Message data");
+    TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(expected, message.data, sizeof(expected), "Message data");
+
+    TEST_ASSERT_FALSE(dccdecode::hasNewMessage());
+    TEST_ASSERT_FALSE(dccdecode::popMessage(message));
 }
 
-int main() {
-    UNITY_BEGIN();
+void testBurstWithinQueueLength() {
+    uint8_t overrunsBefore = dccdecode::getOverrunCount();
+    // Main loop is busy while several packets come in
+    for (uint8_t i = 0; i < dccdecode::QUEUE_LENGTH - 1; i++) {
+        writeAccessoryPacket(0x80 | i, 0xF8);
+    }
+
+    dccdecode::Message message;
+    for (uint8_t i = 0; i < dccdecode::QUEUE_LENGTH - 1; i++) {
+        TEST_ASSERT(dccdecode::popMessage(message));
+        TEST_ASSERT_EQUAL_MESSAGE(message.length, 3, "Message length");
+        TEST_ASSERT_EQUAL_MESSAGE(message.data[0], 0x80 | i, "Messages in order");
+    }
+    TEST_ASSERT_FALSE(dccdecode::popMessage(message));
+    TEST_ASSERT_EQUAL_MESSAGE(dccdecode::getOverrunCount(), overrunsBefore, "No overrun");
+}
+
+void testBurstOverrun() {
+    uint8_t overrunsBefore = dccdecode::getOverrunCount();
+    const uint16_t queueOverrunsBefore = dccdecode::getStatistics().queueOverruns;
+    const uint8_t extraPackets = 3;
+    for (uint8_t i = 0; i < dccdecode::QUEUE_LENGTH - 1 + extraPackets; i++) {
+        writeAccessoryPacket(0x80 | i, 0xF8);
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(dccdecode::getOverrunCount(), overrunsBefore + extraPackets, "Overrun count");
+    TEST_ASSERT_EQUAL_MESSAGE(dccdecode::getStatistics().queueOverruns, queueOverrunsBefore + extraPackets, "Overruns in statistics");
+
+    // The oldest messages survive, the newest got dropped
+    dccdecode::Message message;
+    for (uint8_t i = 0; i < dccdecode::QUEUE_LENGTH - 1; i++) {
+        TEST_ASSERT(dccdecode::popMessage(message));
+        TEST_ASSERT_EQUAL_MESSAGE(message.data[0], 0x80 | i, "Messages in order");
+    }
+    TEST_ASSERT_FALSE(dccdecode::popMessage(message));
+
+    // Reception works normally again after draining
+    writeAccessoryPacket(0xBF, 0x88);
+    TEST_ASSERT(dccdecode::popMessage(message));
+    TEST_ASSERT_EQUAL_MESSAGE(message.data[0], 0xBF, "Message after overrun");
+    TEST_ASSERT_EQUAL_MESSAGE(dccdecode::getOverrunCount(), overrunsBefore + extraPackets, "Overrun count unchanged");
+}
+
+void testReadingSlowerThanReceiving() {
+    // Two packets arrive for every one read: The queue fills up after a few rounds, then
+    // every second packet gets dropped.
+    dccdecode::Message message;
+    uint8_t overrunsBefore = dccdecode::getOverrunCount();
+    for (uint8_t i = 0; i < 4 * dccdecode::QUEUE_LENGTH; i++) {
+        writeAccessoryPacket(0x80 | i, 0xF8);
+        writeAccessoryPacket(0xA0 | i, 0xF8);
+        TEST_ASSERT(dccdecode::popMessage(message));
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(dccdecode::getOverrunCount(), overrunsBefore + 4 * dccdecode::QUEUE_LENGTH - (dccdecode::QUEUE_LENGTH - 2), "Overrun count");
+    while (dccdecode::popMessage(message)) {}
+}
+
+void testEncodedAccessoryAddress() {
+    dccdecode::Message message;
+    const uint16_t addresses[] = { 1, 2, 3, 4, 5, 100, 252 };
+    for (uint16_t address : addresses) {
+        dccencode::BitStream bits;
+        bits.addPacket(dccencode::basicAccessoryPacket(address, true));
+        send(bits);
+
+        TEST_ASSERT(dccdecode::popMessage(message));
+        TEST_ASSERT(message.isBasicAccessoryMessage());
+        TEST_ASSERT_EQUAL_MESSAGE(message.getAccessoryOutputAddress(), address, "Output address");
+    }
+}
+
+void testExtendedAccessory() {
+    dccdecode::Message message;
+    dccencode::BitStream bits;
+    bits.addPacket(dccencode::extendedAccessoryPacket(100, 0x15));
+    send(bits);
+
+    TEST_ASSERT(dccdecode::popMessage(message));
+    TEST_ASSERT(message.isExtendedAccessoryMessage());
+    TEST_ASSERT_FALSE(message.isBasicAccessoryMessage());
+    TEST_ASSERT_EQUAL_MESSAGE(message.getAccessoryOutputAddress(), 100, "Output address");
+    TEST_ASSERT_EQUAL_MESSAGE(message.data[2], 0x15, "Aspect");
+
+    bits.clear();
+    bits.addPacket(dccencode::basicAccessoryPacket(100, true));
+    send(bits);
+    TEST_ASSERT(dccdecode::popMessage(message));
+    TEST_ASSERT_FALSE(message.isExtendedAccessoryMessage());
+}
+
+void testLongestMessage() {
+    // XPOM writing four CVs, 11 bytes with the XOR byte
+    const uint8_t values[] = { 0x11, 0x22, 0x33, 0x44 };
+    dccencode::BitStream bits;
+    bits.addPacket(dccencode::accessoryXpomWritePacket(5, 0x10203, values, sizeof(values), 2));
+    send(bits);
+
+    dccdecode::Message message;
+    TEST_ASSERT(dccdecode::popMessage(message));
+    TEST_ASSERT_EQUAL_MESSAGE(message.length, 11, "Message length");
+    TEST_ASSERT(message.isAccessoryPom());
+    TEST_ASSERT_EQUAL_MESSAGE(message.getAccessoryOutputAddress(), 5, "Output address");
+    const uint8_t expected[] = { 0xEE, 0x01, 0x02, 0x02, 0x11, 0x22, 0x33, 0x44 };
+    TEST_ASSERT_EQUAL_CHAR_ARRAY_MESSAGE(expected, &message.data[2], sizeof(expected), "Instruction, CV and values");
+
+    bits.clear();
+    bits.addPacket(dccencode::accessoryPomWritePacket(5, 1, 3));
+    send(bits);
+    TEST_ASSERT(dccdecode::popMessage(message));
+    TEST_ASSERT(message.isAccessoryPom());
+
+    bits.clear();
+    bits.addPacket(dccencode::extendedAccessoryPacket(5, 1));
+    send(bits);
+    TEST_ASSERT(dccdecode::popMessage(message));
+    TEST_ASSERT_FALSE(message.isAccessoryPom());
+}
+
+bool passesFilter(const dccencode::Packet &packet) {
+    dccencode::BitStream bits;
+    bits.addPacket(packet);
+    send(bits);
+    dccdecode::Message message;
+    return dccdecode::popMessage(message);
+}
+
+bool passesFilter(uint8_t first, uint8_t second) {
+    dccencode::Packet packet;
+    packet.length = 2;
+    packet.data[0] = first;
+    packet.data[1] = second;
+    return passesFilter(packet);
+}
+
+void testPacketFilter() {
+    dccdecode::Statistics before = dccdecode::getStatistics();
+
+    // Three signal heads starting at address 5
+    dccdecode::setPacketFilter(5, 9);
+
+    TEST_ASSERT_FALSE(passesFilter(dccencode::idlePacket()));
+    TEST_ASSERT_FALSE(passesFilter(dccencode::basicAccessoryPacket(4, true)));
+    TEST_ASSERT(passesFilter(dccencode::basicAccessoryPacket(5, true)));
+    TEST_ASSERT(passesFilter(dccencode::basicAccessoryPacket(13, false, false)));
+    TEST_ASSERT_FALSE(passesFilter(dccencode::basicAccessoryPacket(14, true)));
+    TEST_ASSERT_FALSE(passesFilter(0x03, 0x60)); // Locomotive, short address
+    TEST_ASSERT_FALSE(passesFilter(0xC1, 0x00)); // Locomotive, long address
+
+    TEST_ASSERT(passesFilter(dccencode::resetPacket()));
+    TEST_ASSERT(passesFilter(0x00, 0x3F)); // Locomotive broadcast
+    TEST_ASSERT(passesFilter(0xBF, 0x80)); // Accessory broadcast
+    TEST_ASSERT(passesFilter(dccencode::serviceModeWritePacket(1, 3)));
+    TEST_ASSERT(passesFilter(dccencode::accessoryPomWritePacket(100, 1, 3)));
+    const uint8_t xpomValues[] = { 1, 2, 3, 4 };
+    TEST_ASSERT(passesFilter(dccencode::accessoryXpomWritePacket(100, 1, xpomValues, sizeof(xpomValues))));
+    TEST_ASSERT(passesFilter(dccencode::extendedAccessoryPacket(5, 1)));
+    TEST_ASSERT_FALSE(passesFilter(dccencode::extendedAccessoryPacket(14, 1)));
+    dccencode::Packet extendedBroadcast;
+    extendedBroadcast.length = 3;
+    extendedBroadcast.data[0] = 0xBF;
+    extendedBroadcast.data[1] = 0x07;
+    extendedBroadcast.data[2] = 0x00;
+    TEST_ASSERT(passesFilter(extendedBroadcast));
+
+    dccdecode::Statistics after = dccdecode::getStatistics();
+    TEST_ASSERT_EQUAL_MESSAGE(after.filteredPackets - before.filteredPackets, 6, "Filtered packets");
+    TEST_ASSERT_EQUAL_MESSAGE(after.deliveredPackets - before.deliveredPackets, 10, "Delivered packets");
+
+    dccdecode::disablePacketFilter();
+    TEST_ASSERT(passesFilter(dccencode::idlePacket()));
+    TEST_ASSERT(passesFilter(dccencode::basicAccessoryPacket(4, true)));
+}
+
+void testStatisticsReset() {
+    dccdecode::resetStatistics();
+    dccdecode::countAddressedPacket();
+    // As many as fit into the queue
+    for (int i = 0; i < dccdecode::QUEUE_LENGTH - 1; i++) {
+        writeAccessoryPacket(0x81, 0xF8);
+    }
+    dccdecode::Message message;
+    while (dccdecode::popMessage(message)) {}
+
+    dccdecode::Statistics statistics = dccdecode::getStatistics();
+    TEST_ASSERT_EQUAL_MESSAGE(statistics.deliveredPackets, dccdecode::QUEUE_LENGTH - 1, "Delivered packets");
+    TEST_ASSERT_EQUAL_MESSAGE(statistics.addressedPackets, 1, "Addressed packets");
+    TEST_ASSERT_EQUAL_MESSAGE(statistics.preambleRestarts, 0, "No restarts for clean packets");
+    TEST_ASSERT_EQUAL_MESSAGE(statistics.xorErrors, 0, "No XOR errors for clean packets");
+
+    dccdecode::resetStatistics();
+    statistics = dccdecode::getStatistics();
+    TEST_ASSERT_EQUAL(statistics.deliveredPackets, 0);
+    TEST_ASSERT_EQUAL(statistics.addressedPackets, 0);
+    TEST_ASSERT_EQUAL(dccdecode::getOverrunCount(), 0);
+}
+
+// Packets whose bytes all depend on a sequence number, so a message mixed from two packets
+// shows: data[i] == sequence + i * 37
+const uint8_t TORN_TEST_DATA_LENGTH = 5;
+
+dccencode::BitStream tornTestStream;
+size_t tornTestPosition = 0;
+uint8_t tornTestBitsPerInterrupt = 0;
+
+// Feeds the next bits of the stream, like interrupts in the middle of the copy would
+void feedDuringCopy() {
+    for (uint8_t i = 0; i < tornTestBitsPerInterrupt && tornTestPosition < tornTestStream.size(); i++) {
+        receivedBit(tornTestStream.bits[tornTestPosition++]);
+    }
+}
+
+void assertNotTorn(const dccdecode::Message &message) {
+    TEST_ASSERT_EQUAL_MESSAGE(message.length, TORN_TEST_DATA_LENGTH + 1, "Length");
+    uint8_t checksum = 0;
+    for (uint8_t i = 0; i < TORN_TEST_DATA_LENGTH; i++) {
+        TEST_ASSERT_EQUAL_MESSAGE(message.data[i], uint8_t(message.data[0] + i * 37), "Byte from another packet");
+        checksum ^= message.data[i];
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(message.data[TORN_TEST_DATA_LENGTH], checksum, "XOR");
+}
+
+void testNoTornMessages() {
+    const int packetCount = 300;
+    // From a few bits per byte copied (the queue never overflows) to several packets per byte
+    // (it overflows during every copy, and the slot being copied must still stay untouched)
+    const uint8_t bitsPerInterrupt[] = { 1, 7, 30, 200 };
+    dccdecode::Message message;
+    while (dccdecode::popMessage(message)) {}
+
+    for (uint8_t bits : bitsPerInterrupt) {
+        tornTestStream.clear();
+        for (int sequence = 0; sequence < packetCount; sequence++) {
+            uint8_t data[TORN_TEST_DATA_LENGTH];
+            for (uint8_t i = 0; i < TORN_TEST_DATA_LENGTH; i++) {
+                data[i] = uint8_t(sequence + i * 37);
+            }
+            tornTestStream.addPacket(data, sizeof(data));
+        }
+        tornTestPosition = 0;
+        tornTestBitsPerInterrupt = bits;
+        dccdecode::popMessageCopyHook = feedDuringCopy;
+
+        int received = 0;
+        int lastSequence = -1;
+        while (tornTestPosition < tornTestStream.size() || dccdecode::hasNewMessage()) {
+            if (!dccdecode::popMessage(message)) {
+                feedDuringCopy();
+                continue;
+            }
+            assertNotTorn(message);
+            // The sequence number wraps around at 256, but only a few packets get dropped in a row
+            const uint8_t step = uint8_t(message.data[0] - lastSequence);
+            TEST_ASSERT_MESSAGE(lastSequence < 0 || (step > 0 && step < 128), "In order, and none twice");
+            lastSequence = message.data[0];
+            received++;
+        }
+        dccdecode::popMessageCopyHook = nullptr;
+
+        TEST_ASSERT_GREATER_THAN_MESSAGE(0, received, "Messages received");
+        if (bits == 1) {
+            TEST_ASSERT_EQUAL_MESSAGE(received, packetCount, "Nothing dropped while the reader keeps up");
+        }
+    }
+    // The overruns would saturate the counters for the following tests
+    dccdecode::resetStatistics();
+}
+
+// Edge timing tests; these go through whichever core receivedBit() uses.
+
+bool receivesPacketWithTiming(uint8_t oneHalfBit, uint16_t zeroHalfBit, uint8_t startTicks = 0, bool countOverflows = true) {
+    const uint8_t data[] = { 0x81, 0xF9 };
+    dccencode::BitStream bits;
+    bits.addPacket(data, sizeof(data));
+
+    dccencode::EdgeTiming timing;
+    timing.oneHalfBit = oneHalfBit;
+    timing.zeroHalfBit = zeroHalfBit;
+    dccencode::EdgeTrace trace(startTicks);
+    trace.addBits(bits, timing);
+    trace.feed(dccdecode::receivedEdge, countOverflows ? dccdecode::timerOverflowed : nullptr);
+
+    dccdecode::Message message;
+    bool received = dccdecode::popMessage(message);
+    if (received) {
+        TEST_ASSERT_EQUAL_MESSAGE(message.length, 3, "Message length");
+        TEST_ASSERT_EQUAL_MESSAGE(message.data[0], 0x81, "Message data");
+        TEST_ASSERT_EQUAL_MESSAGE(message.data[1], 0xF9, "Message data");
+    }
+    return received;
+}
+
+void testEdgeNominalTiming() {
+    TEST_ASSERT(receivesPacketWithTiming(58, 100));
+    // Timer overflows somewhere in the packet
+    TEST_ASSERT(receivesPacketWithTiming(58, 100, 200));
+    // Stretched zeros up to what the timer can measure
+    TEST_ASSERT(receivesPacketWithTiming(58, 255));
+}
+
+void testEdgeStretchedZeros() {
+    // Around the point where the 8 bit timer wraps around, up to the 10 ms of RCN-210
+    const uint16_t lengths[] = { 255, 256, 257, 256 + dccdecode::DCC_HALF_BIT_ONE_MIN, 345, 511, 512, 1000, 9900 };
+    for (uint16_t length : lengths) {
+        TEST_ASSERT_MESSAGE(receivesPacketWithTiming(58, length), "Stretched zero");
+        TEST_ASSERT_MESSAGE(receivesPacketWithTiming(58, length, 200), "Stretched zero, timer starting at 200");
+    }
+    // Without the overflows, 256 + 58 would look like a 1 and 345 like a short 0
+    TEST_ASSERT_FALSE(receivesPacketWithTiming(58, 256 + 58, 0, false));
+    // A 1 right after an overflow is still a 1
+    TEST_ASSERT(receivesPacketWithTiming(58, 100, 250));
+}
+
+void testEdgeTimingLimits() {
+    TEST_ASSERT(receivesPacketWithTiming(52, 90));
+    TEST_ASSERT(receivesPacketWithTiming(64, 90));
+    TEST_ASSERT_FALSE(receivesPacketWithTiming(51, 100));
+    TEST_ASSERT_FALSE(receivesPacketWithTiming(65, 100));
+    TEST_ASSERT_FALSE(receivesPacketWithTiming(58, 89));
+}
+
+void testEdgeGlitchAbortsPacket() {
+    const uint8_t data[] = { 0x81, 0xF9 };
+    dccencode::BitStream packet;
+    packet.addPacket(data, sizeof(data));
+    // Split in the middle of the second byte
+    size_t split = packet.size() - 15;
+    dccencode::BitStream firstHalf;
+    firstHalf.bits.assign(packet.bits.begin(), packet.bits.begin() + split);
+    dccencode::BitStream secondHalf;
+    secondHalf.bits.assign(packet.bits.begin() + split, packet.bits.end());
+
+    // Valid up to a short spike, and completely valid afterwards
+    dccencode::EdgeTrace trace;
+    trace.addBits(firstHalf);
+    trace.addHalfBit(10);
+    trace.addHalfBit(48);
+    trace.addBits(secondHalf);
+    trace.feed(dccdecode::receivedEdge);
+
+    TEST_ASSERT_FALSE(dccdecode::hasNewMessage());
+
+    // And the next packet gets through
+    TEST_ASSERT(receivesPacketWithTiming(58, 100));
+}
+
+void runTests() {
     RUN_TEST(testInitial);
+    RUN_TEST(testMinimumPreamble);
     RUN_TEST(testShortPreamble);
     RUN_TEST(testInvalidXor);
     RUN_TEST(testOverlyLongMessage);
     RUN_TEST(testReceiveMessage);
+    RUN_TEST(testBurstWithinQueueLength);
+    RUN_TEST(testBurstOverrun);
+    RUN_TEST(testReadingSlowerThanReceiving);
+    RUN_TEST(testEncodedAccessoryAddress);
+    RUN_TEST(testExtendedAccessory);
+    RUN_TEST(testLongestMessage);
+    RUN_TEST(testPacketFilter);
+    RUN_TEST(testStatisticsReset);
+    RUN_TEST(testNoTornMessages);
+}
+
+int main() {
+    UNITY_BEGIN();
+    receivedBit = dccdecode::receivedBitSwitchDecoder;
+    runTests();
+    receivedBit = dccdecode::receivedBitTableDecoder;
+    runTests();
+
+    RUN_TEST(testEdgeNominalTiming);
+    RUN_TEST(testEdgeTimingLimits);
+    RUN_TEST(testEdgeStretchedZeros);
+    RUN_TEST(testEdgeGlitchAbortsPacket);
     UNITY_END();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,155 @@
+#include <main.h>
+#include <hal.h>
+#include <colors.h>
+#include <configuration.h>
+#include <eepromimage.h>
+#include <eepromlayout.h>
+#include <unity.h>
+#include <sstream>
+#include <string.h>
+
+// Images built on the host have to give the decoder exactly the configured CVs.
+
+const char *const exampleConfiguration =
+    "# Two signals at 0x1F5\n"
+    "address = 0x1F5\n"
+    "brightness = 80 ; dimmer\n"
+    "color_order = rgb\n"
+    "heads = 2\n"
+    "workarounds = 1\n"
+    "\n"
+    "red = 200, 10, 0\r\n"
+    "lunar = 50,50,60\n"
+    "cv31 = 3\n"
+    "cv32 = 4\n"
+    "cv81 = 0x82\n";
+
+bool parse(const std::string &text, std::vector<eepromimage::CvWrite> &writes, std::string &error) {
+    std::stringstream stream(text);
+    return eepromimage::parseConfiguration(stream, writes, error);
+}
+
+void assertRejected(const std::string &text, const std::string &expectedError) {
+    std::vector<eepromimage::CvWrite> writes;
+    std::string error;
+    TEST_ASSERT_FALSE_MESSAGE(parse(text, writes, error), text.c_str());
+    TEST_ASSERT_EQUAL_STRING(error.c_str(), expectedError.c_str());
+}
+
+void testParse() {
+    std::vector<eepromimage::CvWrite> writes;
+    std::string error;
+    TEST_ASSERT_TRUE_MESSAGE(parse(exampleConfiguration, writes, error), error.c_str());
+    const eepromimage::CvWrite expected[] = {
+        { 1, 0xF5 }, { 9, 0x01 },
+        { config::CV_INDEX_BRIGHTNESS, 80 },
+        { config::CV_INDEX_COLOR_ORDER, config::Configuration::COLOR_ORDER_RGB },
+        { config::CV_INDEX_NUM_SIGNAL_HEADS, 2 },
+        { config::CV_INDEX_WORKAROUNDS, 1 },
+        { 48, 200 }, { 49, 10 }, { 50, 0 },
+        { 57, 50 }, { 58, 50 }, { 59, 60 },
+        { 31, 3 }, { 32, 4 }, { 81, 0x82 },
+    };
+    TEST_ASSERT_EQUAL(writes.size(), sizeof(expected) / sizeof(expected[0]));
+    for (size_t i = 0; i < writes.size(); i++) {
+        TEST_ASSERT_EQUAL(writes[i].cv, expected[i].cv);
+        TEST_ASSERT_EQUAL(writes[i].value, expected[i].value);
+    }
+}
+
+void testParseErrors() {
+    assertRejected("address = 0\n", "Line 1: address must be 1 to 2047");
+    assertRejected("\nbrightness = 101\n", "Line 2: brightness must be 0 to 100");
+    assertRejected("color_order = bgr\n", "Line 1: color_order must be rgb or grb");
+    assertRejected("heads = 4\n", "Line 1: heads must be 1 to 3");
+    assertRejected("green = 1, 2\n", "Line 1: green must be r, g, b with values 0 to 255");
+    assertRejected("yellow = 1, 2, 256\n", "Line 1: yellow must be r, g, b with values 0 to 255");
+    assertRejected("cvx = 1\n", "Line 1: Unknown CV cvx");
+    assertRejected("colour = 1\n", "Line 1: Unknown key colour");
+    assertRejected("brightness 80\n", "Line 1: Expected key = value");
+}
+
+void testRejectedWrites() {
+    std::string error;
+    TEST_ASSERT_FALSE(eepromimage::apply({ { 7, 2 } }, error));
+    TEST_ASSERT_EQUAL_STRING(error.c_str(), "CV7 can't be set to 2");
+    TEST_ASSERT_FALSE(eepromimage::apply({ { 8, 8 } }, error));
+    // Clamped by the decoder
+    TEST_ASSERT_FALSE(eepromimage::apply({ { config::CV_INDEX_NUM_SIGNAL_HEADS, 9 } }, error));
+    TEST_ASSERT_EQUAL_STRING(error.c_str(), "CV65 would be 3 instead of 9");
+}
+
+void testImageLayout() {
+    std::vector<eepromimage::CvWrite> writes;
+    std::string error;
+    TEST_ASSERT_TRUE(parse(exampleConfiguration, writes, error));
+    TEST_ASSERT_TRUE_MESSAGE(eepromimage::apply(writes, error), error.c_str());
+    const std::vector<uint8_t> image = eepromimage::image();
+
+    TEST_ASSERT_EQUAL(image.size(), eepromlayout::SIZE);
+    TEST_ASSERT_EQUAL_MESSAGE(image[eepromlayout::OFFSET_VERSION], eepromlayout::VERSION, "Decoder keeps the image");
+    TEST_ASSERT_EQUAL_MESSAGE(image[eepromlayout::OFFSET_LED_COUNT], config::MAX_NUM_LEDS, "Built for the same LEDs");
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_ADDRESS], 0xF5);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_ADDRESS + 1], 0x01);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_BRIGHTNESS], 80);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_COLOR_ORDER], config::Configuration::COLOR_ORDER_RGB);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_ACTIVE_SIGNAL_HEADS], 2);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_WORKAROUNDS], 1);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_LED_MAPPING], 0);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_EXTENDED_RANGE_HIGH], 3);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_EXTENDED_RANGE_LOW], 4);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_ASPECTS], colors::RED);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_ASPECTS + 1], 0x82);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_COLORS], 200);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_COLORS + 3 * colors::GREEN + 1], 255);
+    TEST_ASSERT_EQUAL(image[eepromlayout::OFFSET_COLORS + 3 * colors::LUNAR + 2], 60);
+}
+
+void testDecoderReadsImage() {
+    std::vector<eepromimage::CvWrite> writes;
+    std::string error;
+    TEST_ASSERT_TRUE(parse(exampleConfiguration, writes, error));
+    TEST_ASSERT_TRUE(eepromimage::apply(writes, error));
+    const std::vector<uint8_t> image = eepromimage::image();
+
+    // Like avrdude writing the image into a decoder with the defaults
+    writeCvValue(8, 8);
+    hal::host::advanceTime(1000000);
+    TEST_ASSERT_EQUAL(getCvValue(1), 1);
+    memcpy(&eepromlayout::stored, image.data(), image.size());
+    setup();
+
+    TEST_ASSERT_EQUAL(getCvValue(1), 0xF5);
+    TEST_ASSERT_EQUAL(getCvValue(9), 0x01);
+    for (const eepromimage::CvWrite &write : writes) {
+        TEST_ASSERT_EQUAL(getCvValue(write.cv), write.value);
+    }
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_COLOR_BASE + 3 * colors::GREEN + 1), 255);
+    TEST_ASSERT_EQUAL(colors::outputColorValues[colors::RED].r, 160);
+}
+
+void testIntelHex() {
+    std::vector<uint8_t> data;
+    for (uint8_t i = 0; i < 18; i++) {
+        data.push_back(i * 15);
+    }
+    std::stringstream output;
+    eepromimage::writeIntelHex(output, data);
+    TEST_ASSERT_EQUAL_STRING(output.str().c_str(),
+        ":10000000000F1E2D3C4B5A69788796A5B4C3D2E1E8\n"
+        ":02001000F0FFFF\n"
+        ":00000001FF\n");
+}
+
+int main() {
+    setup();
+
+    UNITY_BEGIN();
+    RUN_TEST(testParse);
+    RUN_TEST(testParseErrors);
+    RUN_TEST(testRejectedWrites);
+    RUN_TEST(testImageLayout);
+    RUN_TEST(testDecoderReadsImage);
+    RUN_TEST(testIntelHex);
+    UNITY_END();
+}
@@ -0,0 +1,84 @@
+#include <eepromqueue.h>
+#include <unity.h>
+
+uint8_t eeprom[2 * eepromqueue::LENGTH];
+
+void drain() {
+    eepromqueue::Write write;
+    while (eepromqueue::pop(write)) {
+        *write.address = write.value;
+    }
+}
+
+void testWritesInOrder() {
+    TEST_ASSERT_TRUE(eepromqueue::isEmpty());
+    TEST_ASSERT_TRUE(eepromqueue::push(&eeprom[3], 1));
+    TEST_ASSERT_TRUE(eepromqueue::push(&eeprom[1], 2));
+    TEST_ASSERT_FALSE(eepromqueue::isEmpty());
+
+    eepromqueue::Write write;
+    TEST_ASSERT_TRUE(eepromqueue::pop(write));
+    TEST_ASSERT_EQUAL_PTR(write.address, &eeprom[3]);
+    TEST_ASSERT_EQUAL(write.value, 1);
+    TEST_ASSERT_TRUE(eepromqueue::pop(write));
+    TEST_ASSERT_EQUAL_PTR(write.address, &eeprom[1]);
+    TEST_ASSERT_EQUAL(write.value, 2);
+    TEST_ASSERT_FALSE(eepromqueue::pop(write));
+    TEST_ASSERT_TRUE(eepromqueue::isEmpty());
+}
+
+void testSameAddressOnlyOnce() {
+    TEST_ASSERT_TRUE(eepromqueue::push(&eeprom[0], 1));
+    TEST_ASSERT_TRUE(eepromqueue::push(&eeprom[0], 2));
+
+    uint8_t value = 0;
+    TEST_ASSERT_TRUE(eepromqueue::find(&eeprom[0], value));
+    TEST_ASSERT_EQUAL(value, 2);
+
+    eepromqueue::Write write;
+    TEST_ASSERT_TRUE(eepromqueue::pop(write));
+    TEST_ASSERT_EQUAL(write.value, 2);
+    TEST_ASSERT_FALSE(eepromqueue::pop(write));
+}
+
+void testFull() {
+    // Several times, so the indices wrap around
+    for (int round = 0; round < 20; round++) {
+        for (uint8_t i = 0; i < eepromqueue::LENGTH; i++) {
+            TEST_ASSERT_TRUE(eepromqueue::push(&eeprom[i], i));
+        }
+        TEST_ASSERT_FALSE_MESSAGE(eepromqueue::push(&eeprom[eepromqueue::LENGTH], 1), "Full");
+        // Changing a waiting write still works
+        TEST_ASSERT_TRUE(eepromqueue::push(&eeprom[0], 100 + round));
+        drain();
+        TEST_ASSERT_EQUAL(eeprom[0], 100 + round);
+        TEST_ASSERT_EQUAL(eeprom[eepromqueue::LENGTH - 1], eepromqueue::LENGTH - 1);
+    }
+}
+
+void testReadThrough() {
+    eeprom[5] = 50;
+    eeprom[6] = 60;
+    eeprom[7] = 70;
+    TEST_ASSERT_TRUE(eepromqueue::push(&eeprom[6], 61));
+    // Outside the block read below
+    TEST_ASSERT_TRUE(eepromqueue::push(&eeprom[8], 81));
+
+    uint8_t value;
+    TEST_ASSERT_FALSE(eepromqueue::find(&eeprom[5], value));
+    uint8_t block[3] = { eeprom[5], eeprom[6], eeprom[7] };
+    eepromqueue::overlay(block, &eeprom[5], sizeof(block));
+    TEST_ASSERT_EQUAL(block[0], 50);
+    TEST_ASSERT_EQUAL(block[1], 61);
+    TEST_ASSERT_EQUAL(block[2], 70);
+    drain();
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(testWritesInOrder);
+    RUN_TEST(testSameAddressOnlyOnce);
+    RUN_TEST(testFull);
+    RUN_TEST(testReadThrough);
+    UNITY_END();
+}
@@ -0,0 +1,411 @@
+#include <main.h>
+#include <hal.h>
+#include <colors.h>
+#include <configuration.h>
+#include <eepromlayout.h>
+#include <eepromqueue.h>
+#include <packetcache.h>
+#include <dccencode.h>
+#include <unity.h>
+#include <vector>
+#include <string.h>
+
+// Runs the whole firmware, from DCC bits to LEDs, ACK and EEPROM, on simulated hardware.
+
+hal::host::State &device = hal::host::state;
+
+// Sends the packet the given number of times, handling each like the main loop would
+void send(const dccencode::Packet &packet, int times = 1) {
+    for (int i = 0; i < times; i++) {
+        dccencode::BitStream stream;
+        stream.addPacket(packet);
+        stream.feed(dccdecode::receivedBit);
+        while (dccdecode::hasNewMessage()) {
+            loop();
+        }
+    }
+}
+
+// Lets the given number of animation timer periods pass
+void runFrames(int frames) {
+    for (int i = 0; i < frames; i++) {
+        hal::host::advanceTime(20000);
+        hal::host::fireTimer1();
+        loop();
+    }
+}
+
+// Service mode writes have to be sent twice, after a reset
+bool serviceModeWrite(uint16_t cv, uint8_t value) {
+    const uint32_t acksBefore = device.acks;
+    send(dccencode::resetPacket(), 3);
+    send(dccencode::serviceModeWritePacket(cv, value), 2);
+    // The ACK waits for the EEPROM
+    for (int i = 0; i < 100 && device.acks == acksBefore; i++) {
+        hal::host::advanceTime(1000);
+        loop();
+    }
+    TEST_ASSERT_FALSE_MESSAGE(hal::eepromWritesPending(), "Written before the ACK");
+    const bool acknowledged = device.acks == acksBefore + 1 && device.ackPinOn;
+    // End of the ACK pulse
+    hal::host::fireTimer1();
+    TEST_ASSERT_FALSE_MESSAGE(device.ackPinOn, "ACK pulse ended");
+    return acknowledged;
+}
+
+void assertLed(uint8_t led, colors::ColorName color) {
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&colors::outputColorValues[color], &device.leds[led*3], 3);
+}
+
+void testFactoryReset() {
+    TEST_ASSERT_TRUE_MESSAGE(serviceModeWrite(8, 8), "Reset acknowledged");
+    TEST_ASSERT_EQUAL(getCvValue(1), 1);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_BRIGHTNESS), 100);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_NUM_SIGNAL_HEADS), 1);
+}
+
+void testServiceModeWrite() {
+    const uint32_t eepromBytesBefore = device.eepromBytesWritten;
+    TEST_ASSERT_TRUE_MESSAGE(serviceModeWrite(config::CV_INDEX_NUM_SIGNAL_HEADS, 2), "Write acknowledged");
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_NUM_SIGNAL_HEADS), 2);
+    TEST_ASSERT_EQUAL_MESSAGE(device.eepromBytesWritten, eepromBytesBefore + 1, "One byte written");
+
+    TEST_ASSERT_FALSE_MESSAGE(serviceModeWrite(1000, 1), "No ACK for CVs that don't exist");
+}
+
+void testAckOnlyWhenWritten() {
+    const uint32_t acksBefore = device.acks;
+    send(dccencode::resetPacket(), 3);
+    send(dccencode::serviceModeWritePacket(config::CV_INDEX_BRIGHTNESS, 80), 2);
+    // Readable right away, but not in the EEPROM yet
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_BRIGHTNESS), 80);
+    TEST_ASSERT_TRUE(hal::eepromWritesPending());
+    loop();
+    TEST_ASSERT_EQUAL_MESSAGE(device.acks, acksBefore, "No ACK before the write is done");
+
+    hal::host::advanceTime(hal::host::EEPROM_WRITE_MICROSECONDS);
+    loop();
+    TEST_ASSERT_EQUAL_MESSAGE(device.acks, acksBefore + 1, "ACK after the write");
+    hal::host::fireTimer1();
+}
+
+void testFactoryResetOnlyWaitsForFullQueue() {
+    // Change everything a reset touches
+    send(dccencode::resetPacket(), 3);
+    for (uint8_t i = 0; i < 3 * colors::COUNT; i++) {
+        writeCvValue(48 + i, 1);
+    }
+    writeCvValue(config::CV_INDEX_BRIGHTNESS, 1);
+    writeCvValue(config::CV_INDEX_COLOR_ORDER, 0);
+    writeCvValue(1, 2);
+    hal::host::advanceTime(1000000);
+
+    const uint32_t blockedBefore = device.eepromBlockedMicroseconds;
+    const uint32_t synchronousBefore = device.eepromSynchronousMicroseconds;
+    TEST_ASSERT_TRUE_MESSAGE(serviceModeWrite(8, 8), "Reset acknowledged");
+    const uint32_t blocked = device.eepromBlockedMicroseconds - blockedBefore;
+    const uint32_t synchronous = device.eepromSynchronousMicroseconds - synchronousBefore;
+    TEST_ASSERT_GREATER_THAN_MESSAGE(50000, synchronous, "Would have blocked without the queue");
+    // Only the writes that don't fit into the queue wait, each for one write to finish
+    const uint32_t queued = eepromqueue::LENGTH * hal::host::EEPROM_WRITE_MICROSECONDS;
+    TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(synchronous > queued ? synchronous - queued : 0, blocked, "Main loop only waited for room in the queue");
+    TEST_ASSERT_EQUAL(getCvValue(1), 1);
+    TEST_ASSERT_EQUAL(getCvValue(48), 255);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_BRIGHTNESS), 100);
+}
+
+void testLedsOffWhileProgramming() {
+    send(dccencode::resetPacket(), 3);
+    const uint8_t dark[6] = { 0 };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(dark, device.leds, sizeof(dark));
+    runFrames(10);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(dark, device.leds, sizeof(dark));
+}
+
+void testAccessoryCommands() {
+    // The first command gets the decoder out of programming mode
+    send(dccencode::basicAccessoryPacket(1, true));
+    runFrames(50);
+    // The lowest address is the bottom head, which is the last in the chain
+    assertLed(0, colors::RED);
+    assertLed(1, colors::GREEN);
+    TEST_ASSERT_FALSE_MESSAGE(device.timer1Running, "Animation timer stopped when done");
+
+    send(dccencode::basicAccessoryPacket(5, true));
+    runFrames(50);
+    assertLed(0, colors::YELLOW);
+    assertLed(1, colors::GREEN);
+
+    // Not our address
+    const uint32_t transmissionsBefore = device.ledTransmissions;
+    send(dccencode::basicAccessoryPacket(7, false));
+    runFrames(50);
+    TEST_ASSERT_EQUAL(device.ledTransmissions, transmissionsBefore);
+}
+
+void testPomWrite() {
+    send(dccencode::accessoryPomWritePacket(1, config::CV_INDEX_BRIGHTNESS, 50), 2);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_BRIGHTNESS), 50);
+
+    // The LEDs show the new brightness
+    runFrames(5);
+    assertLed(0, colors::YELLOW);
+    assertLed(1, colors::GREEN);
+    TEST_ASSERT_EQUAL_UINT8(device.leds[3], 127);
+}
+
+void testXpomWrite() {
+    const uint8_t values[] = { 10, 20, 30, 40 };
+    const dccencode::Packet packet = dccencode::accessoryXpomWritePacket(1, 48, values, sizeof(values), 1);
+    send(packet);
+    TEST_ASSERT_EQUAL_MESSAGE(getCvValue(48), 255, "Only written when repeated");
+
+    const uint32_t eepromBytesBefore = device.eepromBytesWritten;
+    send(packet);
+    for (uint8_t i = 0; i < sizeof(values); i++) {
+        TEST_ASSERT_EQUAL(getCvValue(48 + i), values[i]);
+    }
+    hal::host::advanceTime(1000000);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(values, eepromlayout::stored.colors, sizeof(values));
+    TEST_ASSERT_EQUAL_MESSAGE(device.eepromBytesWritten, eepromBytesBefore + sizeof(values), "Four bytes written");
+
+    // CV 67 doesn't exist, so none of them get written
+    const uint8_t tooFar[] = { 1, 2, 1, 0 };
+    send(dccencode::accessoryXpomWritePacket(1, config::CV_INDEX_COLOR_ORDER, tooFar, sizeof(tooFar), 2), 2);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_COLOR_ORDER), config::Configuration::COLOR_ORDER_GRB);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_NUM_SIGNAL_HEADS), 2);
+
+    // Bit manipulation: 1110-10SS with 111K-DBBB
+    const uint8_t setBit0 = 0xF8;
+    dccencode::Packet bitWrite = dccencode::accessoryXpomWritePacket(1, config::CV_INDEX_WORKAROUNDS, &setBit0, 1, 3);
+    bitWrite.data[2] = 0xE8 | 3;
+    send(bitWrite, 2);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_WORKAROUNDS), config::WORKAROUND_BIT_POM_ADDRESSING);
+    writeCvValue(config::CV_INDEX_WORKAROUNDS, 0);
+}
+
+// Every CV that a layout would set, in order
+struct CvWrite {
+    uint16_t cv;
+    uint8_t value;
+};
+
+std::vector<CvWrite> fullConfiguration() {
+    std::vector<CvWrite> writes;
+    writes.push_back({ config::CV_INDEX_BRIGHTNESS, 80 });
+    for (uint8_t i = 0; i < 3 * colors::COUNT; i++) {
+        writes.push_back({ uint16_t(config::CV_INDEX_COLOR_BASE + i), uint8_t(i * 17) });
+    }
+    writes.push_back({ config::CV_INDEX_COLOR_ORDER, config::Configuration::COLOR_ORDER_RGB });
+    writes.push_back({ config::CV_INDEX_NUM_SIGNAL_HEADS, config::MAX_NUM_SIGNAL_HEADS });
+    writes.push_back({ config::CV_INDEX_WORKAROUNDS, 0 });
+    for (uint8_t i = 0; i < config::ASPECT_COUNT; i++) {
+        writes.push_back({ uint16_t(config::CV_INDEX_ASPECT_BASE + i), uint8_t((i & config::ASPECT_COLOR_MASK) | (i >= 4 ? config::ASPECT_BIT_FLASHING : 0)) });
+    }
+    for (uint8_t i = 0; i < config::MAX_NUM_LEDS; i++) {
+        writes.push_back({ uint16_t(config::CV_INDEX_LED_MAPPING_BASE + i), uint8_t(config::MAX_NUM_LEDS - 1 - i) });
+    }
+    return writes;
+}
+
+// What the EEPROM holds once all writes are done
+std::vector<uint8_t> eepromImage() {
+    hal::host::advanceTime(1000000);
+    const uint8_t *stored = (const uint8_t *) &eepromlayout::stored;
+    return std::vector<uint8_t>(stored, stored + eepromlayout::SIZE);
+}
+
+void testOtherLayoutFallsBackToDefaults() {
+    writeCvValue(1, 42);
+    writeCvValue(config::CV_INDEX_BRIGHTNESS, 50);
+    hal::host::advanceTime(1000000);
+    setup();
+    TEST_ASSERT_EQUAL_MESSAGE(getCvValue(1), 42, "Current layout kept");
+
+    // As written by older firmware, which had the address first
+    eepromlayout::stored.ledCount = 42;
+    eepromlayout::stored.version = 0;
+    setup();
+    TEST_ASSERT_EQUAL(getCvValue(1), 1);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_BRIGHTNESS), 100);
+    TEST_ASSERT_EQUAL(eepromImage()[eepromlayout::OFFSET_VERSION], eepromlayout::VERSION);
+
+    // Built with more LEDs, so the aspects and colors are further back
+    writeCvValue(1, 42);
+    hal::host::advanceTime(1000000);
+    eepromlayout::stored.ledCount = config::MAX_NUM_LEDS + 1;
+    setup();
+    TEST_ASSERT_EQUAL(getCvValue(1), 1);
+    TEST_ASSERT_EQUAL(eepromImage()[eepromlayout::OFFSET_LED_COUNT], config::MAX_NUM_LEDS);
+
+    // Blank
+    memset(&eepromlayout::stored, 0xFF, sizeof(eepromlayout::stored));
+    setup();
+    TEST_ASSERT_EQUAL(getCvValue(1), 1);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_NUM_SIGNAL_HEADS), 1);
+    TEST_ASSERT_EQUAL(getCvValue(config::CV_INDEX_COLOR_BASE + 3 * colors::GREEN + 1), 255);
+    TEST_ASSERT_EQUAL(eepromImage()[eepromlayout::OFFSET_VERSION], eepromlayout::VERSION);
+}
+
+// Returns the number of packets sent
+uint32_t configureWithPom(const std::vector<CvWrite> &writes) {
+    uint32_t packets = 0;
+    for (const CvWrite &write : writes) {
+        send(dccencode::accessoryPomWritePacket(1, write.cv, write.value), 2);
+        packets += 2;
+    }
+    return packets;
+}
+
+uint32_t configureWithXpom(const std::vector<CvWrite> &writes) {
+    uint32_t packets = 0;
+    uint8_t sequence = 0;
+    for (size_t start = 0; start < writes.size();) {
+        // Up to four consecutive CVs per packet
+        uint8_t values[4];
+        uint8_t count = 0;
+        while (count < sizeof(values) && start + count < writes.size() && writes[start + count].cv == writes[start].cv + count) {
+            values[count] = writes[start + count].value;
+            count++;
+        }
+        send(dccencode::accessoryXpomWritePacket(1, writes[start].cv, values, count, sequence++), 2);
+        packets += 2;
+        start += count;
+    }
+    return packets;
+}
+
+void testXpomFullConfiguration() {
+    const std::vector<CvWrite> writes = fullConfiguration();
+
+    writeCvValue(8, 8);
+    const uint32_t pomPackets = configureWithPom(writes);
+    const std::vector<uint8_t> pomImage = eepromImage();
+
+    writeCvValue(8, 8);
+    TEST_ASSERT_FALSE(eepromImage() == pomImage);
+    const uint32_t xpomPackets = configureWithXpom(writes);
+    const std::vector<uint8_t> xpomImage = eepromImage();
+
+    for (const CvWrite &write : writes) {
+        TEST_ASSERT_EQUAL_MESSAGE(getCvValue(write.cv), write.value, "Written");
+    }
+    TEST_ASSERT_TRUE_MESSAGE(xpomImage == pomImage, "Same EEPROM image");
+    // 30 CVs, in four runs of consecutive CVs, each packet sent twice
+    TEST_ASSERT_EQUAL(writes.size(), 30);
+    TEST_ASSERT_EQUAL_MESSAGE(pomPackets, 60, "POM packets");
+    TEST_ASSERT_EQUAL_MESSAGE(xpomPackets, 16, "XPOM packets");
+
+    writeCvValue(8, 8);
+}
+
+void testFlashing() {
+    send(dccencode::basicAccessoryPacket(3, true));
+    runFrames(1);
+    uint32_t transmissionsBefore = device.ledTransmissions;
+    runFrames(100);
+    TEST_ASSERT_GREATER_THAN(transmissionsBefore + 50, device.ledTransmissions);
+
+    send(dccencode::basicAccessoryPacket(3, false));
+    runFrames(100);
+    assertLed(1, colors::GREEN);
+    TEST_ASSERT_FALSE(device.timer1Running);
+}
+
+void testExtendedAccessory() {
+    // One address per head: 1 is the bottom head (LED 1), 2 the top one (LED 0)
+    send(dccencode::extendedAccessoryPacket(2, 6)); // Yellow, flashing
+    send(dccencode::extendedAccessoryPacket(1, 1)); // Green
+    runFrames(1);
+    const uint32_t transmissionsBefore = device.ledTransmissions;
+    runFrames(100);
+    TEST_ASSERT_GREATER_THAN_MESSAGE(transmissionsBefore + 50, device.ledTransmissions, "Flashing");
+    assertLed(1, colors::GREEN);
+
+    send(dccencode::extendedAccessoryPacket(2, 2)); // Yellow, steady
+    runFrames(100);
+    TEST_ASSERT_FALSE_MESSAGE(device.timer1Running, "Flashing stopped");
+    assertLed(0, colors::YELLOW);
+
+    // Aspects without a CV and other addresses get ignored
+    send(dccencode::extendedAccessoryPacket(2, config::ASPECT_COUNT));
+    send(dccencode::extendedAccessoryPacket(3, 0));
+    runFrames(10);
+    TEST_ASSERT_FALSE(device.timer1Running);
+
+    // The mapping is configurable
+    TEST_ASSERT_TRUE(writeCvValue(config::CV_INDEX_ASPECT_BASE + 0, colors::LUNAR));
+    send(dccencode::extendedAccessoryPacket(1, 0));
+    runFrames(100);
+    assertLed(1, colors::LUNAR);
+    TEST_ASSERT_TRUE(writeCvValue(config::CV_INDEX_ASPECT_BASE + 0, colors::RED));
+
+    // Broadcast sets all heads
+    dccencode::Packet broadcast;
+    broadcast.length = 3;
+    broadcast.data[0] = 0xBF;
+    broadcast.data[1] = 0x07;
+    broadcast.data[2] = 0;
+    send(broadcast);
+    runFrames(100);
+    assertLed(0, colors::RED);
+    assertLed(1, colors::RED);
+}
+
+void testRepeatedCommands() {
+    const packetcache::Statistics before = packetcache::getStatistics();
+    send(dccencode::basicAccessoryPacket(1, false), 4);
+    runFrames(1);
+    send(dccencode::basicAccessoryPacket(1, true), 4);
+    runFrames(100);
+    assertLed(1, colors::GREEN);
+    const packetcache::Statistics after = packetcache::getStatistics();
+    TEST_ASSERT_EQUAL_MESSAGE(after.droppedRepeats - before.droppedRepeats, 6, "Repeats dropped");
+
+    // Switching back within the expiry time still works
+    send(dccencode::basicAccessoryPacket(1, false), 4);
+    runFrames(100);
+    assertLed(1, colors::RED);
+}
+
+void testBusHealthCvs() {
+    TEST_ASSERT_TRUE_MESSAGE(writeCvValue(config::CV_INDEX_STATISTICS_BASE, 0), "Reset counters");
+
+    // A packet with a wrong XOR byte, then one for us and one for someone else
+    dccencode::BitStream broken;
+    broken.addPreamble();
+    broken.addByte(0x81);
+    broken.addByte(0xF9);
+    broken.addByte(0x00);
+    broken.addPacketEnd();
+    broken.feed(dccdecode::receivedBit);
+    send(dccencode::basicAccessoryPacket(1, true));
+    send(dccencode::basicAccessoryPacket(200, true));
+
+    const uint16_t base = config::CV_INDEX_STATISTICS_BASE;
+    TEST_ASSERT_EQUAL_MESSAGE(getCvValue(base + 2 * 2), 1, "Addressed packets");
+    TEST_ASSERT_EQUAL_MESSAGE(getCvValue(base + 4 * 2), 1, "XOR errors");
+    TEST_ASSERT_EQUAL_MESSAGE(getCvValue(base + 2 * 2 + 1), 0, "High byte");
+    TEST_ASSERT_FALSE_MESSAGE(writeCvValue(base + 4 * 2, 1), "Read-only");
+}
+
+int main() {
+    setup();
+
+    UNITY_BEGIN();
+    RUN_TEST(testFactoryReset);
+    RUN_TEST(testFactoryResetOnlyWaitsForFullQueue);
+    RUN_TEST(testAckOnlyWhenWritten);
+    RUN_TEST(testServiceModeWrite);
+    RUN_TEST(testLedsOffWhileProgramming);
+    RUN_TEST(testAccessoryCommands);
+    RUN_TEST(testPomWrite);
+    RUN_TEST(testFlashing);
+    RUN_TEST(testExtendedAccessory);
+    RUN_TEST(testRepeatedCommands);
+    RUN_TEST(testBusHealthCvs);
+    RUN_TEST(testXpomWrite);
+    RUN_TEST(testXpomFullConfiguration);
+    RUN_TEST(testOtherLayoutFallsBackToDefaults);
+    UNITY_END();
+}
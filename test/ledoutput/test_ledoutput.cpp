@@ -0,0 +1,280 @@
+#include <ledoutput.h>
+#include <dccdecode.h>
+#include <dccencode.h>
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+// Timing model of LEDOUTPUT_CHUNKED: a DCC signal, sampled DCC_WAIT_TIME after each falling
+// edge like the firmware does, and the WS2812 chain getting the chunks that ledoutput hands
+// out after each sample. Nothing here depends on the host being fast; all times are µs of
+// the modelled signal.
+
+// From the falling edge that starts a RailCom cutout to the next one. The decoder sees the
+// cutout as a 0 bit.
+const uint16_t CUTOUT_PERIOD = 488;
+// Longest low time that the LEDs don't take as a reset; anything in between that and
+// LATCH_MICROSECONDS may or may not latch them.
+const uint16_t LONGEST_UNLATCHED = 2 * ledoutput::LONGEST_ZERO_HALF_BIT + ledoutput::SAMPLE_OVERHEAD;
+const uint32_t FRAME_PERIOD = 20000;
+
+struct Bit {
+    bool value;
+    // Until the next falling edge
+    uint16_t period;
+};
+
+struct Signal {
+    uint8_t oneHalfBit;
+    uint8_t zeroHalfBit;
+    uint8_t preambleLength;
+    bool railcom;
+};
+
+const Signal signals[] = {
+    { 58, 100, 14, false },
+    { 58, 100, 16, true },
+    { dccdecode::DCC_HALF_BIT_ONE_MIN, dccdecode::DCC_HALF_BIT_ZERO_MIN, 10, false },
+    { dccdecode::DCC_HALF_BIT_ONE_MIN, dccdecode::DCC_HALF_BIT_ZERO_MIN, 10, true },
+    { dccdecode::DCC_HALF_BIT_ONE_MAX, ledoutput::LONGEST_ZERO_HALF_BIT, 14, false },
+    { dccdecode::DCC_HALF_BIT_ONE_MAX, ledoutput::LONGEST_ZERO_HALF_BIT, 14, true },
+};
+
+void addPacket(std::vector<Bit> &bits, const Signal &signal, const dccencode::Packet &packet) {
+    dccencode::BitStream stream;
+    stream.addPacket(packet, signal.preambleLength);
+    for (bool value : stream.bits) {
+        bits.push_back({ value, uint16_t(2 * (value ? signal.oneHalfBit : signal.zeroHalfBit)) });
+    }
+    if (signal.railcom) {
+        bits.push_back({ false, CUTOUT_PERIOD });
+    }
+}
+
+// Accessory traffic with idle packets, POM and the three byte packets with the fewest 0s
+std::vector<Bit> mixedTraffic(const Signal &signal, uint16_t packets) {
+    srand(42);
+    dccencode::Packet fewestZeros;
+    fewestZeros.length = 2;
+    fewestZeros.data[0] = 0xFF;
+    fewestZeros.data[1] = 0xFF;
+
+    std::vector<Bit> bits;
+    for (uint16_t i = 0; i < packets; i++) {
+        switch (rand() % 5) {
+            case 0: addPacket(bits, signal, dccencode::idlePacket()); break;
+            case 1: addPacket(bits, signal, dccencode::basicAccessoryPacket(rand() % 2044, rand() % 2)); break;
+            case 2: addPacket(bits, signal, dccencode::extendedAccessoryPacket(rand() % 2044, rand() % 32)); break;
+            case 3: addPacket(bits, signal, dccencode::accessoryPomWritePacket(rand() % 2044, rand() % 1024 + 1, rand() % 256)); break;
+            default: addPacket(bits, signal, fewestZeros); break;
+        }
+    }
+    return bits;
+}
+
+struct Result {
+    uint32_t delayedEdges = 0;
+    // Gaps between chunks after which the LEDs may or may not have latched
+    uint32_t ambiguousGaps = 0;
+    uint32_t framesStarted = 0;
+    uint32_t framesCompleted = 0;
+    // Frames that the LEDs showed, and the ones they showed wrong
+    uint32_t framesShown = 0;
+    uint32_t framesShownWrong = 0;
+    uint32_t longestFrame = 0;
+};
+
+// The WS2812 chain. Bytes get shifted in after one another, and show once the line stays
+// low long enough.
+struct Chain {
+    std::vector<uint8_t> received;
+    std::vector<uint8_t> shown;
+    // Earliest and latest time the last chunk can have ended
+    uint64_t lastEndMin = 0;
+    uint64_t lastEndMax = 0;
+    bool latched = true;
+
+    // A chunk that starts within SAMPLE_OVERHEAD after the sample. Returns whether the LEDs
+    // latched before it.
+    bool send(Result &result, uint64_t sampleTime, const uint8_t *data, uint8_t length) {
+        const uint64_t gapMin = sampleTime - lastEndMax;
+        const uint64_t gapMax = sampleTime + ledoutput::SAMPLE_OVERHEAD - lastEndMin;
+        bool didLatch = false;
+        if (gapMin >= ledoutput::LATCH_MICROSECONDS) {
+            didLatch = latch();
+        } else if (gapMax > LONGEST_UNLATCHED) {
+            result.ambiguousGaps++;
+        }
+        received.insert(received.end(), data, data + length);
+        latched = false;
+        lastEndMin = sampleTime + length * ledoutput::MICROSECONDS_PER_BYTE;
+        lastEndMax = lastEndMin + ledoutput::SAMPLE_OVERHEAD;
+        return didLatch;
+    }
+
+    bool latch() {
+        if (latched) {
+            return false;
+        }
+        shown = received;
+        received.clear();
+        latched = true;
+        return true;
+    }
+};
+
+// Counts the last complete frame as shown once the LEDs latched after it
+void checkShown(Result &result, const Chain &chain, std::vector<uint8_t> &completed) {
+    if (completed.empty()) {
+        return;
+    }
+    result.framesShown++;
+    if (chain.shown.size() < completed.size() || !std::equal(completed.begin(), completed.end(), chain.shown.begin())) {
+        result.framesShownWrong++;
+    }
+    completed.clear();
+}
+
+// Runs the signal through the decoder, starting a new frame of the given length every
+// FRAME_PERIOD unless the last one is still going out, like updateAnimation() does.
+Result simulate(const std::vector<Bit> &bits, uint8_t frameLength) {
+    Result result;
+    Chain chain;
+    ledoutput::takeRest();
+
+    uint8_t frame[256];
+    std::vector<uint8_t> completed;
+    uint64_t frameStart = 0;
+    uint64_t nextFrame = 0;
+    uint64_t time = 0;
+    for (const Bit &bit : bits) {
+        if (time >= nextFrame && !ledoutput::isBusy()) {
+            for (uint16_t i = 0; i < frameLength; i++) {
+                frame[i] = uint8_t(result.framesStarted * 7 + i);
+            }
+            ledoutput::start(frame, frameLength);
+            result.framesStarted++;
+            frameStart = time;
+            nextFrame += FRAME_PERIOD;
+        }
+
+        const uint64_t sampleTime = time + dccdecode::DCC_WAIT_TIME;
+        dccdecode::receivedBit(bit.value);
+        const bool wasBusy = ledoutput::isBusy();
+        const ledoutput::Chunk chunk = ledoutput::afterSample(bit.value, dccdecode::endedPacket(bit.value));
+        if (chunk.length > 0) {
+            if (chain.send(result, sampleTime, chunk.data, chunk.length)) {
+                checkShown(result, chain, completed);
+            }
+            if (sampleTime + ledoutput::SAMPLE_OVERHEAD + chunk.length * ledoutput::MICROSECONDS_PER_BYTE > time + bit.period) {
+                result.delayedEdges++;
+            }
+        }
+        if (wasBusy && !ledoutput::isBusy()) {
+            result.framesCompleted++;
+            completed.assign(frame, frame + frameLength);
+            const uint64_t duration = time + bit.period - frameStart;
+            if (duration > result.longestFrame) {
+                result.longestFrame = uint32_t(duration);
+            }
+        }
+        time += bit.period;
+    }
+
+    // The line stays low
+    chain.latch();
+    checkShown(result, chain, completed);
+    dccdecode::Message message;
+    while (dccdecode::popMessage(message)) {}
+    return result;
+}
+
+void testNoEdgeDelayed() {
+    char text[80];
+    for (const Signal &signal : signals) {
+        const std::vector<Bit> bits = mixedTraffic(signal, 300);
+        for (uint16_t leds = 1; leds * 3 <= ledoutput::BYTES_PER_PACKET; leds++) {
+            const Result result = simulate(bits, leds * 3);
+            snprintf(text, sizeof(text), "%d LEDs, half-bits %d/%d µs%s", leds, signal.oneHalfBit, signal.zeroHalfBit, signal.railcom ? ", RailCom" : "");
+            TEST_ASSERT_EQUAL_MESSAGE(result.delayedEdges, 0, text);
+            TEST_ASSERT_EQUAL_MESSAGE(result.ambiguousGaps, 0, text);
+            TEST_ASSERT_GREATER_THAN_MESSAGE(10, result.framesCompleted, text);
+            // Only the last one may not be done yet
+            TEST_ASSERT_GREATER_OR_EQUAL_MESSAGE(result.framesStarted - 1, result.framesCompleted, text);
+            TEST_ASSERT_EQUAL_MESSAGE(result.framesShown, result.framesCompleted, text);
+            TEST_ASSERT_EQUAL_MESSAGE(result.framesShownWrong, 0, text);
+            // Otherwise updateAnimation() sends the rest at once
+            TEST_ASSERT_LESS_THAN_MESSAGE(2 * FRAME_PERIOD, result.longestFrame, text);
+        }
+    }
+}
+
+void testWorstCasePackets() {
+    // Nothing but the three byte packets with the fewest 0s, with the shortest preamble;
+    // BYTES_PER_PACKET is exactly what fits in between two of them.
+    dccencode::Packet fewestZeros;
+    fewestZeros.length = 2;
+    fewestZeros.data[0] = 0xFF;
+    fewestZeros.data[1] = 0xFF;
+    const Signal signal = signals[2];
+    std::vector<Bit> bits;
+    for (uint16_t i = 0; i < 300; i++) {
+        addPacket(bits, signal, fewestZeros);
+    }
+
+    const Result fits = simulate(bits, ledoutput::BYTES_PER_PACKET);
+    TEST_ASSERT_EQUAL(fits.delayedEdges, 0);
+    TEST_ASSERT_GREATER_THAN(10, fits.framesCompleted);
+    TEST_ASSERT_EQUAL(fits.framesShownWrong, 0);
+
+    const Result tooLong = simulate(bits, ledoutput::BYTES_PER_PACKET + 1);
+    TEST_ASSERT_EQUAL(tooLong.delayedEdges, 0);
+    TEST_ASSERT_EQUAL(tooLong.framesCompleted, 0);
+}
+
+void testChunkSizes() {
+    static const uint8_t frame[20] = {};
+    ledoutput::takeRest();
+    // The LEDs have to latch before anything gets sent
+    for (uint8_t i = 0; i < ledoutput::LATCH_SAMPLES; i++) {
+        ledoutput::afterSample(true, false);
+    }
+    ledoutput::start(frame, sizeof(frame));
+    TEST_ASSERT_TRUE(ledoutput::isBusy());
+
+    ledoutput::Chunk chunk = ledoutput::afterSample(true, false);
+    TEST_ASSERT_EQUAL_PTR(chunk.data, frame);
+    TEST_ASSERT_EQUAL(chunk.length, ledoutput::BYTES_AFTER_ONE);
+    chunk = ledoutput::afterSample(false, false);
+    TEST_ASSERT_EQUAL_PTR(chunk.data, frame + ledoutput::BYTES_AFTER_ONE);
+    TEST_ASSERT_EQUAL(chunk.length, ledoutput::BYTES_AFTER_ZERO);
+
+    // Starts over after the packet, once the LEDs had time to latch
+    chunk = ledoutput::afterSample(true, true);
+    TEST_ASSERT_EQUAL(chunk.length, 0);
+    for (uint8_t i = 1; i < ledoutput::LATCH_SAMPLES; i++) {
+        TEST_ASSERT_EQUAL(ledoutput::afterSample(false, false).length, 0);
+    }
+    chunk = ledoutput::afterSample(false, false);
+    TEST_ASSERT_EQUAL_PTR(chunk.data, frame);
+    TEST_ASSERT_EQUAL(chunk.length, ledoutput::BYTES_AFTER_ZERO);
+
+    // Without a DCC signal, the whole frame goes out at once
+    chunk = ledoutput::takeRest();
+    TEST_ASSERT_EQUAL_PTR(chunk.data, frame);
+    TEST_ASSERT_EQUAL(chunk.length, sizeof(frame));
+    TEST_ASSERT_FALSE(ledoutput::isBusy());
+    TEST_ASSERT_EQUAL(ledoutput::takeRest().length, 0);
+    TEST_ASSERT_EQUAL(ledoutput::afterSample(false, false).length, 0);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(testChunkSizes);
+    RUN_TEST(testNoEdgeDelayed);
+    RUN_TEST(testWorstCasePackets);
+    UNITY_END();
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <packetcache.h>
+#include <dccencode.h>
+#include <unity.h>
+
+dccdecode::Message message(const dccencode::Packet &packet) {
+    dccdecode::Message message;
+    message.length = packet.length + 1;
+    uint8_t checksum = 0;
+    for (uint8_t i = 0; i < packet.length; i++) {
+        message.data[i] = packet.data[i];
+        checksum ^= packet.data[i];
+    }
+    message.data[packet.length] = checksum;
+    return message;
+}
+
+const dccdecode::Message red = message(dccencode::basicAccessoryPacket(1, false));
+const dccdecode::Message green = message(dccencode::basicAccessoryPacket(1, true));
+const dccdecode::Message greenOff = message(dccencode::basicAccessoryPacket(1, true, false));
+
+void testRepeatsDropped() {
+    packetcache::flush();
+    const packetcache::Statistics before = packetcache::getStatistics();
+    TEST_ASSERT_FALSE(packetcache::isRepeat(red, 0));
+    TEST_ASSERT_TRUE(packetcache::isRepeat(red, 1));
+    TEST_ASSERT_TRUE(packetcache::isRepeat(red, 2));
+    TEST_ASSERT_FALSE_MESSAGE(packetcache::isRepeat(green, 2), "Different packet");
+    TEST_ASSERT_TRUE(packetcache::isRepeat(green, 3));
+    TEST_ASSERT_TRUE_MESSAGE(packetcache::isRepeat(red, 3), "Older packet still there");
+
+    const packetcache::Statistics after = packetcache::getStatistics();
+    TEST_ASSERT_EQUAL(after.checkedPackets - before.checkedPackets, 6);
+    TEST_ASSERT_EQUAL(after.droppedRepeats - before.droppedRepeats, 4);
+}
+
+void testExpiry() {
+    packetcache::flush();
+    TEST_ASSERT_FALSE(packetcache::isRepeat(red, 250));
+    TEST_ASSERT_TRUE(packetcache::isRepeat(red, uint8_t(250 + packetcache::EXPIRY_FRAMES - 1)));
+    TEST_ASSERT_FALSE_MESSAGE(packetcache::isRepeat(red, uint8_t(250 + packetcache::EXPIRY_FRAMES)), "Expired, across the wrap-around");
+    TEST_ASSERT_TRUE_MESSAGE(packetcache::isRepeat(red, uint8_t(250 + packetcache::EXPIRY_FRAMES)), "Remembered again");
+}
+
+void testStateChanged() {
+    packetcache::flush();
+    // Red, then green: A repeat of red now has to switch back
+    TEST_ASSERT_FALSE(packetcache::isRepeat(red, 0));
+    TEST_ASSERT_FALSE(packetcache::isRepeat(greenOff, 0));
+    TEST_ASSERT_FALSE(packetcache::isRepeat(green, 0));
+    packetcache::stateChanged();
+    TEST_ASSERT_TRUE_MESSAGE(packetcache::isRepeat(green, 1), "The newest packet stays");
+    TEST_ASSERT_FALSE_MESSAGE(packetcache::isRepeat(red, 1), "Older ones are gone");
+    TEST_ASSERT_FALSE(packetcache::isRepeat(greenOff, 1));
+
+    packetcache::flush();
+    TEST_ASSERT_FALSE(packetcache::isRepeat(red, 1));
+}
+
+void testOldestReplaced() {
+    packetcache::flush();
+    for (uint16_t address = 1; address <= packetcache::LENGTH + 1; address++) {
+        TEST_ASSERT_FALSE(packetcache::isRepeat(message(dccencode::basicAccessoryPacket(address, true)), 0));
+    }
+    TEST_ASSERT_FALSE_MESSAGE(packetcache::isRepeat(message(dccencode::basicAccessoryPacket(1, true)), 0), "Oldest replaced");
+    TEST_ASSERT_TRUE(packetcache::isRepeat(message(dccencode::basicAccessoryPacket(packetcache::LENGTH + 1, true)), 0));
+}
+
+void testOnlyAccessoryCommands() {
+    packetcache::flush();
+    const dccdecode::Message others[] = {
+        message(dccencode::accessoryPomWritePacket(1, 47, 3)),
+        message(dccencode::serviceModeWritePacket(47, 3)),
+        message(dccencode::resetPacket()),
+        message(dccencode::idlePacket()),
+    };
+    for (const dccdecode::Message &other : others) {
+        TEST_ASSERT_FALSE(packetcache::isRepeat(other, 0));
+        TEST_ASSERT_FALSE_MESSAGE(packetcache::isRepeat(other, 0), "Never cached");
+    }
+
+    const dccdecode::Message aspect = message(dccencode::extendedAccessoryPacket(1, 3));
+    TEST_ASSERT_FALSE(packetcache::isRepeat(aspect, 0));
+    TEST_ASSERT_TRUE(packetcache::isRepeat(aspect, 0));
+    TEST_ASSERT_FALSE_MESSAGE(packetcache::isRepeat(message(dccencode::extendedAccessoryPacket(1, 4)), 0), "Other aspect");
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(testRepeatsDropped);
+    RUN_TEST(testExpiry);
+    RUN_TEST(testStateChanged);
+    RUN_TEST(testOldestReplaced);
+    RUN_TEST(testOnlyAccessoryCommands);
+    UNITY_END();
+}
@@ -0,0 +1,183 @@
+#include <dccreplay.h>
+#include <dccencode.h>
+#include <fstream>
+#include <sstream>
+#include <unity.h>
+
+// The captures next to this file are synthetic (see the comments in them); real recordings
+// can go next to them once someone has made some.
+
+// Set in platformio.ini, since the test may run from any directory
+#ifndef REPLAY_FIXTURE_DIR
+#define REPLAY_FIXTURE_DIR "test/replay"
+#endif
+
+// Fails the test if the capture isn't there, instead of replaying nothing
+bool loadFixture(const char *name, dccreplay::Capture &capture, const std::string &channel = "") {
+    const std::string path = std::string(REPLAY_FIXTURE_DIR) + "/" + name;
+    const bool opened = std::ifstream(path).good();
+    TEST_ASSERT_TRUE_MESSAGE(opened, ("Can't open " + path).c_str());
+    std::string error;
+    const bool loaded = opened && dccreplay::readCapture(path, capture, error, channel);
+    TEST_ASSERT_TRUE_MESSAGE(!opened || loaded, error.c_str());
+    return loaded;
+}
+
+dccdecode::Message message(const dccencode::Packet &packet) {
+    dccdecode::Message message;
+    message.length = packet.length + 1;
+    uint8_t checksum = 0;
+    for (uint8_t i = 0; i < packet.length; i++) {
+        message.data[i] = packet.data[i];
+        checksum ^= packet.data[i];
+    }
+    message.data[packet.length] = checksum;
+    return message;
+}
+
+// What the captures contain
+const dccdecode::Message packets[] = {
+    message(dccencode::idlePacket()),
+    message(dccencode::resetPacket()),
+    message(dccencode::basicAccessoryPacket(5, true, true)),
+    message(dccencode::basicAccessoryPacket(5, true, false)),
+    message(dccencode::extendedAccessoryPacket(9, 3)),
+    message(dccencode::accessoryPomWritePacket(5, 47, 80)),
+    message(dccencode::idlePacket()),
+};
+const uint8_t PACKET_COUNT = sizeof(packets) / sizeof(packets[0]);
+const uint8_t GLITCHED_PACKET = 2;
+const uint8_t CORRUPT_PACKET = 5;
+
+void assertPackets(const dccreplay::Result &result, bool glitchLost, bool corruptLost) {
+    size_t decoded = 0;
+    for (uint8_t i = 0; i < PACKET_COUNT; i++) {
+        if ((glitchLost && i == GLITCHED_PACKET) || (corruptLost && i == CORRUPT_PACKET)) {
+            continue;
+        }
+        if (decoded >= result.packets.size()) {
+            TEST_FAIL_MESSAGE("Packet missing");
+            return;
+        }
+        const dccdecode::Message &actual = result.packets[decoded].message;
+        TEST_ASSERT_EQUAL(actual.length, packets[i].length);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(actual.data, packets[i].data, packets[i].length);
+        decoded++;
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(result.packets.size(), decoded, "Additional packets");
+}
+
+void testParseCsv() {
+    // Without a time column, at the sample rate from the comment
+    std::istringstream samples("; Samplerate: 1 MHz\nD0,D1\n0,1\n0,1\n1,1\n1,0\n0,0\n");
+    dccreplay::Capture capture;
+    std::string error;
+    TEST_ASSERT_TRUE(dccreplay::parseCsv(samples, capture, error));
+    TEST_ASSERT_FALSE(capture.initialLevel);
+    TEST_ASSERT_EQUAL(capture.edges.size(), 2);
+    TEST_ASSERT_EQUAL(capture.edges[0].time, 2000);
+    TEST_ASSERT_TRUE(capture.edges[0].level);
+    TEST_ASSERT_EQUAL(capture.edges[1].time, 4000);
+    TEST_ASSERT_EQUAL(capture.endTime, 4000);
+
+    samples.clear();
+    samples.seekg(0);
+    TEST_ASSERT_TRUE(dccreplay::parseCsv(samples, capture, error, "D1"));
+    TEST_ASSERT_TRUE(capture.initialLevel);
+    TEST_ASSERT_EQUAL(capture.edges.size(), 1);
+    TEST_ASSERT_EQUAL(capture.edges[0].time, 3000);
+
+    samples.clear();
+    samples.seekg(0);
+    TEST_ASSERT_FALSE(dccreplay::parseCsv(samples, capture, error, "DCC"));
+
+    std::istringstream changes("Time [us],DCC\r\n0.0,1\r\n12.5,0\r\n70,1\r\n");
+    TEST_ASSERT_TRUE(dccreplay::parseCsv(changes, capture, error));
+    TEST_ASSERT_EQUAL(capture.edges.size(), 2);
+    TEST_ASSERT_EQUAL(capture.edges[0].time, 12500);
+    TEST_ASSERT_EQUAL(capture.edges[1].time, 70000);
+
+    std::istringstream noRate("0\n1\n");
+    TEST_ASSERT_FALSE(dccreplay::parseCsv(noRate, capture, error));
+}
+
+void testParseVcd() {
+    std::istringstream dump(
+        "$timescale 10ns $end\n"
+        "$scope module top $end $var wire 8 # bus $end $var wire 1 ! clock $end\n"
+        "$var wire 1 \" DCC $end $upscope $end $enddefinitions $end\n"
+        "#0 $dumpvars 0! 1\" b101 # $end\n"
+        "#5 1! b0 #\n"
+        "#7 0\"\n"
+        "#9 x\" 1\"\n"
+        "#20\n");
+    dccreplay::Capture capture;
+    std::string error;
+    TEST_ASSERT_TRUE(dccreplay::parseVcd(dump, capture, error, "DCC"));
+    TEST_ASSERT_TRUE(capture.initialLevel);
+    TEST_ASSERT_EQUAL(capture.edges.size(), 2);
+    TEST_ASSERT_EQUAL(capture.edges[0].time, 70);
+    TEST_ASSERT_FALSE(capture.edges[0].level);
+    TEST_ASSERT_EQUAL(capture.edges[1].time, 90);
+    TEST_ASSERT_EQUAL(capture.endTime, 200);
+
+    dump.clear();
+    dump.seekg(0);
+    TEST_ASSERT_TRUE(dccreplay::parseVcd(dump, capture, error));
+    TEST_ASSERT_FALSE_MESSAGE(capture.initialLevel, "First 1 bit variable");
+    TEST_ASSERT_EQUAL(capture.edges.size(), 1);
+}
+
+void testCleanCapture() {
+    dccreplay::Capture capture;
+    if (!loadFixture("synthetic_pulseview.csv", capture, "DCC")) {
+        return;
+    }
+
+    // DCC doesn't depend on the polarity, so the inverted signal has to work just the same
+    for (bool inverted: { false, true }) {
+        for (uint8_t input = 0; input < dccreplay::INPUT_COUNT; input++) {
+            const dccreplay::Result result = dccreplay::replay(capture, dccreplay::Input(input));
+            assertPackets(result, false, false);
+            TEST_ASSERT_EQUAL(result.statistics.deliveredPackets, PACKET_COUNT);
+            // Inverted, the capture starts in the middle of a bit, which may look like a short preamble
+            TEST_ASSERT_TRUE(result.statistics.preambleRestarts <= (inverted ? 1 : 0));
+            TEST_ASSERT_EQUAL(result.statistics.xorErrors, 0);
+            TEST_ASSERT_EQUAL(result.statistics.lengthOverflows, 0);
+        }
+        if (!inverted) {
+            capture.invert();
+        }
+    }
+}
+
+void testNoisyCapture() {
+    dccreplay::Capture capture;
+    if (!loadFixture("synthetic_noisy.vcd", capture)) {
+        return;
+    }
+
+    // The glitch is in a high half-bit, where it only restarts the sampling timer
+    for (dccreplay::Input input: { dccreplay::INPUT_SAMPLED_SWITCH_DECODER, dccreplay::INPUT_SAMPLED_TABLE_DECODER }) {
+        const dccreplay::Result result = dccreplay::replay(capture, input);
+        assertPackets(result, false, true);
+        TEST_ASSERT_EQUAL(result.statistics.xorErrors, 1);
+        TEST_ASSERT_EQUAL(result.statistics.preambleRestarts, 0);
+    }
+
+    // Edge timing sees two out of spec half-bits and drops the packet
+    const dccreplay::Result result = dccreplay::replay(capture, dccreplay::INPUT_EDGE_TIMING);
+    assertPackets(result, true, true);
+    TEST_ASSERT_EQUAL(result.statistics.xorErrors, 1);
+    TEST_ASSERT_TRUE(result.statistics.preambleRestarts > 0);
+    TEST_ASSERT_EQUAL(result.decoderCalls, capture.edges.size());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(testParseCsv);
+    RUN_TEST(testParseVcd);
+    RUN_TEST(testNoisyCapture);
+    RUN_TEST(testCleanCapture);
+    UNITY_END();
+}
@@ -0,0 +1,164 @@
+#include <signalbank.h>
+#include <configuration.h>
+#include <cvtable.h>
+#include <unity.h>
+
+const uint8_t DARK = config::LED_MAPPING_DARK;
+
+// Runs frames until the animation timer stops. Returns the bytes that would have been sent
+// in total.
+template<uint8_t Heads, uint8_t LedsPerHead>
+int runUntilIdle(SignalBank<Heads, LedsPerHead> &bank, uint8_t activeHeads) {
+    int bytesSent = 0;
+    SignalHead::startAnimationTimer();
+    for (int frame = 0; frame < 1000 && SignalHead::isAnimationTimerRunning(); frame++) {
+        bytesSent += bank.update(activeHeads);
+    }
+    TEST_ASSERT_FALSE_MESSAGE(SignalHead::isAnimationTimerRunning(), "Animation did not finish");
+    return bytesSent;
+}
+
+void assertLed(const uint8_t *leds, uint8_t led, colors::ColorName color) {
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&colors::outputColorValues[color], &leds[led*3], 3);
+}
+
+void assertLedDark(const uint8_t *leds, uint8_t led) {
+    const uint8_t dark[3] = { 0, 0, 0 };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(dark, &leds[led*3], 3);
+}
+
+void testSeveralLedsPerHead() {
+    const uint8_t mapping[] = { 0, 0, 0, 1, 1, 1 };
+    SignalBank<2, 3> bank(mapping);
+    runUntilIdle(bank, 2);
+    bank.heads[1].setColor(colors::GREEN);
+    runUntilIdle(bank, 2);
+
+    for (uint8_t led = 0; led < 3; led++) {
+        assertLed(bank.leds, led, colors::RED);
+    }
+    for (uint8_t led = 3; led < 6; led++) {
+        assertLed(bank.leds, led, colors::GREEN);
+    }
+}
+
+void testCustomMapping() {
+    // Second head first, then a dark LED, then the first head twice
+    const uint8_t mapping[] = { 1, DARK, 0, 0 };
+    SignalBank<2, 2> bank(mapping);
+    bank.heads[0].setColor(colors::YELLOW);
+    bank.heads[1].setColor(colors::LUNAR);
+    runUntilIdle(bank, 2);
+
+    assertLed(bank.leds, 0, colors::LUNAR);
+    assertLedDark(bank.leds, 1);
+    assertLed(bank.leds, 2, colors::YELLOW);
+    assertLed(bank.leds, 3, colors::YELLOW);
+}
+
+void testInactiveHeadsStayDark() {
+    const uint8_t mapping[] = { 2, 0, 1, 1, 1, 1 };
+    SignalBank<3, 2> bank(mapping);
+    runUntilIdle(bank, 3);
+    bank.fill(0);
+
+    // Only two heads and with that four LEDs are active
+    const int bytesSent = runUntilIdle(bank, 2);
+    TEST_ASSERT_EQUAL_MESSAGE(bytesSent, 4 * 3, "Only active LEDs get sent");
+    assertLedDark(bank.leds, 0);
+    assertLed(bank.leds, 1, colors::RED);
+    assertLed(bank.leds, 2, colors::RED);
+    assertLed(bank.leds, 3, colors::RED);
+}
+
+void testSendsUpToLastChangedLed() {
+    // The first head is at the end of the chain
+    const uint8_t mapping[] = { 1, 1, 2, 2, 0, 0 };
+    SignalBank<3, 2> bank(mapping);
+    runUntilIdle(bank, 3);
+
+    SignalHead::startAnimationTimer();
+    bank.heads[1].setFlashing(true);
+    for (int frame = 0; frame < 10; frame++) {
+        const uint8_t length = bank.update(3);
+        TEST_ASSERT_TRUE_MESSAGE(length == 0 || length == 2 * 3, "Only the first head's LEDs");
+    }
+    bank.heads[1].setFlashing(false);
+    runUntilIdle(bank, 3);
+
+    SignalHead::startAnimationTimer();
+    bank.heads[0].setFlashing(true);
+    for (int frame = 0; frame < 10; frame++) {
+        const uint8_t length = bank.update(3);
+        TEST_ASSERT_TRUE_MESSAGE(length == 0 || length == 6 * 3, "Whole chain for the last LEDs");
+    }
+    bank.heads[0].setFlashing(false);
+    runUntilIdle(bank, 3);
+}
+
+void testRedrawAfterFill() {
+    const uint8_t mapping[] = { 0, 1 };
+    SignalBank<2, 1> bank(mapping);
+    bank.heads[1].setColor(colors::GREEN);
+    runUntilIdle(bank, 2);
+
+    // E.g. the LEDs were off for programming
+    bank.fill(0);
+    TEST_ASSERT_EQUAL_MESSAGE(runUntilIdle(bank, 2), 2 * 3, "Everything sent again");
+    assertLed(bank.leds, 0, colors::RED);
+    assertLed(bank.leds, 1, colors::GREEN);
+
+    bank.redraw();
+    TEST_ASSERT_EQUAL_MESSAGE(runUntilIdle(bank, 2), 2 * 3, "Everything sent again");
+    TEST_ASSERT_EQUAL_MESSAGE(runUntilIdle(bank, 2), 0, "Nothing changed");
+}
+
+void testMappingCvs() {
+    config::resetConfigurationToDefault();
+    for (uint8_t led = 0; led < config::MAX_NUM_LEDS; led++) {
+        TEST_ASSERT_EQUAL(cvtable::read(config::CV_INDEX_LED_MAPPING_BASE + led), led / config::LEDS_PER_HEAD);
+    }
+    TEST_ASSERT_EQUAL(cvtable::read(config::CV_INDEX_LED_MAPPING_BASE + config::MAX_NUM_LEDS), 0xFFFF);
+
+    TEST_ASSERT_EQUAL(cvtable::write(config::CV_INDEX_LED_MAPPING_BASE, config::MAX_NUM_SIGNAL_HEADS), cvtable::WRITE_REJECTED);
+    TEST_ASSERT_EQUAL(cvtable::write(config::CV_INDEX_LED_MAPPING_BASE, DARK), cvtable::WRITE_DONE);
+    TEST_ASSERT_EQUAL(cvtable::write(config::CV_INDEX_LED_MAPPING_BASE + 1, 0), cvtable::WRITE_DONE);
+
+    config::loadConfiguration();
+    TEST_ASSERT_EQUAL(config::values.ledMapping[0], DARK);
+    TEST_ASSERT_EQUAL(config::values.ledMapping[1], 0);
+}
+
+void testEightHeadsFit() {
+    // Pointers are larger on the host, so this holds on the ATtiny85 as well
+    TEST_ASSERT_LESS_OR_EQUAL(256, sizeof(SignalBank<8, 2>));
+
+    uint8_t mapping[16];
+    for (uint8_t led = 0; led < 16; led++) {
+        mapping[led] = led / 2;
+    }
+    SignalBank<8, 2> bank(mapping);
+    for (uint8_t head = 0; head < 8; head++) {
+        bank.heads[head].setColor(head % 2 ? colors::GREEN : colors::YELLOW);
+    }
+    runUntilIdle(bank, 8);
+    assertLed(bank.leds, 14, colors::GREEN);
+    assertLed(bank.leds, 15, colors::GREEN);
+    assertLed(bank.leds, 12, colors::YELLOW);
+}
+
+int main() {
+    config::values.brightness = config::BRIGHTNESS_MAX;
+    config::values.colorOrder = config::Configuration::COLOR_ORDER_RGB;
+    colors::restoreDefaultColorsToEeprom();
+
+    UNITY_BEGIN();
+    RUN_TEST(testSeveralLedsPerHead);
+    RUN_TEST(testCustomMapping);
+    RUN_TEST(testInactiveHeadsStayDark);
+    RUN_TEST(testSendsUpToLastChangedLed);
+    RUN_TEST(testRedrawAfterFill);
+    RUN_TEST(testMappingCvs);
+    RUN_TEST(testEightHeadsFit);
+    UNITY_END();
+}
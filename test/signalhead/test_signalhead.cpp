@@ -0,0 +1,271 @@
+#include <signalbank.h>
+#include <configuration.h>
+#include <signalanimations.h>
+#include <unity.h>
+
+const uint8_t HEAD_COUNT = 3;
+const uint8_t ledMapping[HEAD_COUNT] = { 0, 1, 2 };
+SignalBank<HEAD_COUNT, 1> bank(ledMapping);
+SignalHead *heads = bank.heads;
+const uint8_t *frame = bank.leds;
+// What would have been sent to the LEDs
+int bytesSent = 0;
+int transmissions = 0;
+
+// Simulates the main loop for the given number of animation timer periods, returns the
+// number of frames that got calculated.
+int runTimesteps(int timesteps) {
+    int frames = 0;
+    for (int i = 0; i < timesteps; i++) {
+        if (SignalHead::isAnimationTimerRunning()) {
+            uint8_t length = bank.update(HEAD_COUNT);
+            if (length > 0) {
+                bytesSent += length;
+                transmissions++;
+            }
+            frames++;
+        }
+    }
+    return frames;
+}
+
+void testStartupFrame() {
+    SignalHead::setupTimer1();
+    // One frame to show the initial color, then nothing
+    TEST_ASSERT_EQUAL_MESSAGE(runTimesteps(100), 1, "Frames after startup");
+    TEST_ASSERT_FALSE(SignalHead::isAnimationTimerRunning());
+    TEST_ASSERT_EQUAL_MESSAGE(frame[0], 255, "Red");
+    TEST_ASSERT_EQUAL_MESSAGE(frame[1], 0, "Red");
+}
+
+void testColorSwitch() {
+    heads[1].setColor(colors::GREEN);
+    TEST_ASSERT(SignalHead::isAnimationTimerRunning());
+    int frames = runTimesteps(100);
+    TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(25, frames, "Frames for a color switch");
+    TEST_ASSERT_EQUAL_MESSAGE(frame[3], 0, "Green");
+    TEST_ASSERT_EQUAL_MESSAGE(frame[4], 255, "Green");
+
+    // Switching to the color it already has does nothing
+    heads[1].setColor(colors::GREEN);
+    TEST_ASSERT_EQUAL_MESSAGE(runTimesteps(100), 0, "Frames for no change");
+}
+
+void testFlashing() {
+    heads[2].setFlashing(true);
+    TEST_ASSERT_EQUAL_MESSAGE(runTimesteps(200), 200, "Frames while flashing");
+
+    heads[2].setFlashing(false);
+    int frames = runTimesteps(200);
+    // Finishes the current flash cycle
+    TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(50, frames, "Frames for ending flashing");
+    TEST_ASSERT_EQUAL_MESSAGE(frame[6], 255, "Red and fully on");
+}
+
+void testFlashingInSync() {
+    // A head that starts flashing later joins the phase of the one already flashing
+    heads[0].setFlashing(true);
+    runTimesteps(10);
+    heads[1].setFlashing(true);
+    bool dimmed = false;
+    for (int i = 0; i < 100; i++) {
+        runTimesteps(1);
+        TEST_ASSERT_EQUAL_MESSAGE(frame[4], frame[0], "Green as bright as red");
+        dimmed = dimmed || frame[0] < 255;
+    }
+    TEST_ASSERT_TRUE(dimmed);
+
+    heads[0].setFlashing(false);
+    heads[1].setFlashing(false);
+    runTimesteps(100);
+    TEST_ASSERT_FALSE(SignalHead::isAnimationTimerRunning());
+    TEST_ASSERT_EQUAL_MESSAGE(frame[0], 255, "Red and fully on");
+    TEST_ASSERT_EQUAL_MESSAGE(frame[4], 255, "Green and fully on");
+}
+
+void testScriptedSequence() {
+    // An hour at 20 ms per timestep with a few commands in between
+    const int timestepsPerCommand = 180000 / 5;
+    int frames = 0;
+
+    heads[0].setColor(colors::YELLOW);
+    frames += runTimesteps(timestepsPerCommand);
+    heads[0].setColor(colors::GREEN);
+    heads[1].setColor(colors::RED);
+    frames += runTimesteps(timestepsPerCommand);
+    heads[2].setFlashing(true);
+    frames += runTimesteps(100);
+    heads[2].setFlashing(false);
+    frames += runTimesteps(timestepsPerCommand);
+    heads[0].setColor(colors::RED);
+    frames += runTimesteps(timestepsPerCommand);
+
+    // Only what the switches and flashing take, none while idle
+    TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(300, frames, "Frames in an hour");
+    TEST_ASSERT_FALSE(SignalHead::isAnimationTimerRunning());
+}
+
+void testTransmitOnlyChanges() {
+    // Only the first head changes, so only its LED gets sent
+    bytesSent = 0;
+    transmissions = 0;
+    heads[0].setColor(colors::GREEN);
+    int frames = runTimesteps(100);
+    TEST_ASSERT_GREATER_THAN(0, transmissions);
+    TEST_ASSERT_LESS_THAN(frames, transmissions);
+    TEST_ASSERT_EQUAL_MESSAGE(bytesSent, 3 * transmissions, "Bytes for first head");
+
+    // The last head needs the whole chain
+    bytesSent = 0;
+    transmissions = 0;
+    heads[2].setColor(colors::YELLOW);
+    runTimesteps(100);
+    TEST_ASSERT_EQUAL_MESSAGE(bytesSent, 9 * transmissions, "Bytes for last head");
+
+    // Nothing at all while idle, even if something (like the configuration) starts the timer
+    bytesSent = 0;
+    SignalHead::startAnimationTimer();
+    TEST_ASSERT_EQUAL_MESSAGE(runTimesteps(100), 1, "Frames without change");
+    TEST_ASSERT_EQUAL_MESSAGE(bytesSent, 0, "Bytes without change");
+
+    // A changed palette does get sent
+    colors::colorValues[colors::RED].b = 10;
+    colors::updateOutputColors();
+    SignalHead::startAnimationTimer();
+    runTimesteps(100);
+    TEST_ASSERT_EQUAL_MESSAGE(bytesSent, 6, "Bytes for palette change");
+}
+
+#ifndef ANIMATION_EASING
+// AnimationPlayer as it was before stepping, dividing on every frame
+class ReferencePlayer {
+    uint8_t phaseTimestep = 0;
+    uint8_t phaseIndex;
+
+    static const uint8_t *select(const uint8_t *a, const uint8_t *b, uint8_t index) {
+        switch (index) {
+            case 0: return a;
+            case 1: return b;
+            default: return (const uint8_t*) &colors::outputColorValues[index-2];
+        }
+    }
+
+public:
+    ReferencePlayer(uint8_t initialAnimation) : phaseIndex(initialAnimation) {}
+
+    void setAnimation(uint8_t index) {
+        phaseTimestep = 0;
+        phaseIndex = index;
+    }
+
+    bool isComplete() {
+        return (animations[phaseIndex].flags & 0x80) != 0;
+    }
+
+    void updateColor(const uint8_t *a, const uint8_t *b, uint8_t *out) {
+        const AnimationPhase *currentPhase = &animations[phaseIndex];
+        const uint8_t *inputStart = select(a, b, (currentPhase->flags >> 4) & 0x7);
+        const uint8_t *inputEnd = select(a, b, currentPhase->flags & 0x7);
+        for (int i = 0; i < 3; i++) {
+            out[i] = uint8_t(int16_t(phaseTimestep) * int16_t(inputEnd[i] - inputStart[i]) / int16_t(currentPhase->length)) + inputStart[i];
+        }
+
+        phaseTimestep += 1;
+        if (phaseTimestep >= currentPhase->length) {
+            phaseTimestep = 0;
+            phaseIndex = currentPhase->next;
+        }
+    }
+};
+
+// SignalHead as it was when each head had its own player for flashing
+class ReferenceHead {
+    colors::ColorName switchingFrom = colors::RED;
+    colors::ColorName switchingTo = colors::RED;
+    colors::ColorName nextAfter = colors::UNDEFINED;
+    bool isFlashing = false;
+    ReferencePlayer colorSwitching = ReferencePlayer(ANIMATION_SWITCH_DONE);
+    ReferencePlayer flashing = ReferencePlayer(ANIMATION_START_FLASHING);
+
+public:
+    void setAspect(colors::ColorName color, bool flashing) {
+        if (switchingTo != color) {
+            nextAfter = color;
+        }
+        isFlashing = flashing;
+    }
+
+    void updateColor(uint8_t *colors) {
+        colorSwitching.updateColor((const uint8_t *) &colors::outputColorValues[switchingFrom], (const uint8_t *) &colors::outputColorValues[switchingTo], colors);
+        if (colorSwitching.isComplete() && nextAfter != colors::UNDEFINED) {
+            switchingFrom = switchingTo;
+            switchingTo = nextAfter;
+            nextAfter = colors::UNDEFINED;
+            colorSwitching.setAnimation(switchingFrom == colors::RED || switchingTo == colors::RED ? ANIMATION_START_SWITCH_DIRECT : ANIMATION_START_SWITCH_INTERMEDIATE_RED);
+        }
+        if (isFlashing || !flashing.isComplete()) {
+            flashing.updateColor(colors, (const uint8_t *) &colors::outputColorValues[colors::UNDEFINED], colors);
+        }
+    }
+};
+
+void testFlashingMatchesOwnPlayers() {
+    SignalHead head;
+    ReferenceHead reference;
+    uint8_t actual[3] = {};
+    uint8_t expected[3] = {};
+
+    // Flashing with a steady color, while switching colors, and after a palette change
+    struct Command {
+        int frame;
+        colors::ColorName color;
+        bool flashing;
+    };
+    const Command commands[] = {
+        { 0, colors::RED, true },
+        { 57, colors::GREEN, true },
+        { 130, colors::GREEN, false },
+        { 200, colors::YELLOW, true },
+        { 223, colors::LUNAR, true },
+        { 300, colors::LUNAR, false },
+        { 310, colors::RED, true },
+    };
+    uint8_t next = 0;
+    for (int frame = 0; frame < 400; frame++) {
+        if (next < sizeof(commands) / sizeof(commands[0]) && commands[next].frame == frame) {
+            head.setAspect(commands[next].color, commands[next].flashing);
+            reference.setAspect(commands[next].color, commands[next].flashing);
+            next++;
+        }
+        if (frame == 250) {
+            colors::colorValues[colors::LUNAR].g = 99;
+            colors::updateOutputColors();
+        }
+
+        SignalHead::updateFlashingPhase();
+        head.updateColor(actual);
+        reference.updateColor(expected);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, actual, 3);
+    }
+    colors::restoreDefaultColorsToEeprom();
+}
+#endif
+
+int main() {
+    config::values.brightness = config::BRIGHTNESS_MAX;
+    config::values.colorOrder = config::Configuration::COLOR_ORDER_RGB;
+    colors::restoreDefaultColorsToEeprom();
+
+    UNITY_BEGIN();
+    RUN_TEST(testStartupFrame);
+    RUN_TEST(testColorSwitch);
+    RUN_TEST(testFlashing);
+    RUN_TEST(testFlashingInSync);
+    RUN_TEST(testScriptedSequence);
+    RUN_TEST(testTransmitOnlyChanges);
+#ifndef ANIMATION_EASING
+    RUN_TEST(testFlashingMatchesOwnPlayers);
+#endif
+    UNITY_END();
+    return 0;
+}
@@ -0,0 +1,118 @@
+// Replays a logic analyzer capture of the DCC line through the decoder and prints what it
+// decoded, how many problems it saw and how fast it was. Build and run with
+//   pio run -e dccreplay && .pio/build/dccreplay/program [options] capture.csv|capture.vcd
+
+#include <dccreplay.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+static void printUsage() {
+  fprintf(stderr,
+    "Usage: dccreplay [options] capture.csv|capture.vcd\n"
+    "  --channel NAME  Column or variable with the DCC signal (default: the first one)\n"
+    "  --invert        The probe sees the inverted signal\n"
+    "  --input MODE    sampled, table, edges or all (default: all)\n"
+    "  --quiet         Only print the statistics, not every packet\n");
+}
+
+static void printPacket(const dccreplay::DecodedPacket &packet) {
+  const dccdecode::Message &message = packet.message;
+  printf("%12.6f ms ", packet.time / 1e6);
+  for (uint8_t i = 0; i < message.length; i++) {
+    printf(" %02X", message.data[i]);
+  }
+  // Room for the longest message, so the descriptions line up
+  printf("%*s", 3 * int(sizeof(message.data) - message.length), "");
+  if (message.isGeneralReset()) {
+    printf("  reset");
+  } else if (message.length == 3 && message.data[0] == 0xFF && message.data[1] == 0) {
+    printf("  idle");
+  } else if (message.isExtendedAccessoryMessage()) {
+    printf("  extended accessory %u, aspect %u", message.getAccessoryOutputAddress(), message.data[2]);
+  } else if (message.isBasicAccessoryMessage()) {
+    printf("  accessory %u, D=%u C=%u", message.getAccessoryOutputAddress(), message.data[1] & 0x01, (message.data[1] & 0x08) >> 3);
+  }
+  printf("\n");
+}
+
+static void printResult(const dccreplay::Capture &capture, dccreplay::Input input, const dccreplay::Result &result) {
+  const dccdecode::Statistics &statistics = result.statistics;
+  const double captureSeconds = capture.endTime / 1e9;
+  printf("%s:\n", dccreplay::inputName(input));
+  printf("  Packets:           %zu\n", result.packets.size());
+  printf("  Preamble restarts: %u\n", statistics.preambleRestarts);
+  printf("  XOR errors:        %u\n", statistics.xorErrors);
+  printf("  Length overflows:  %u\n", statistics.lengthOverflows);
+  printf("  Queue overruns:    %u\n", statistics.queueOverruns);
+  if (captureSeconds > 0) {
+    printf("  Packets/s on the line: %.1f\n", result.packets.size() / captureSeconds);
+  }
+  if (result.hostSeconds > 0) {
+    printf("  Decoder calls/s:       %.3g\n", result.decoderCalls / result.hostSeconds);
+    printf("  Faster than real time: %.0fx\n", captureSeconds / result.hostSeconds);
+  }
+}
+
+int main(int argc, char **argv) {
+  std::string channel;
+  std::string path;
+  bool invert = false;
+  bool quiet = false;
+  int firstInput = 0;
+  int lastInput = dccreplay::INPUT_COUNT - 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--channel") == 0 && i + 1 < argc) {
+      channel = argv[++i];
+    } else if (strcmp(argv[i], "--invert") == 0) {
+      invert = true;
+    } else if (strcmp(argv[i], "--quiet") == 0) {
+      quiet = true;
+    } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+      const std::string mode = argv[++i];
+      if (mode == "sampled") {
+        firstInput = lastInput = dccreplay::INPUT_SAMPLED_SWITCH_DECODER;
+      } else if (mode == "table") {
+        firstInput = lastInput = dccreplay::INPUT_SAMPLED_TABLE_DECODER;
+      } else if (mode == "edges") {
+        firstInput = lastInput = dccreplay::INPUT_EDGE_TIMING;
+      } else if (mode != "all") {
+        printUsage();
+        return 1;
+      }
+    } else if (argv[i][0] != '-' && path.empty()) {
+      path = argv[i];
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (path.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  dccreplay::Capture capture;
+  std::string error;
+  if (!dccreplay::readCapture(path, capture, error, channel)) {
+    fprintf(stderr, "%s: %s\n", path.c_str(), error.c_str());
+    return 1;
+  }
+  if (invert) {
+    capture.invert();
+  }
+  printf("%s: %zu edges in %.3f s\n", path.c_str(), capture.edges.size(), capture.endTime / 1e9);
+
+  for (int input = firstInput; input <= lastInput; input++) {
+    const dccreplay::Result result = dccreplay::replay(capture, dccreplay::Input(input));
+    // The packets are the same for all inputs unless the capture is noisy, so print them once
+    if (!quiet && input == firstInput) {
+      for (const dccreplay::DecodedPacket &packet : result.packets) {
+        printPacket(packet);
+      }
+    }
+    printResult(capture, dccreplay::Input(input), result);
+  }
+  return 0;
+}
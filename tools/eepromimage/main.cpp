@@ -0,0 +1,40 @@
+// Builds an EEPROM image from a decoder configuration, so a decoder gets its firmware and its
+// configuration in one avrdude run. Build and run with
+//   pio run -e eepromimage && .pio/build/eepromimage/program decoder.conf decoder.eep
+// then flash with e.g.
+//   avrdude ... -U flash:w:firmware.hex:i -U eeprom:w:decoder.eep:i
+// See src/eepromimage.h for the configuration format; anything not in it keeps its default.
+// The image is for the head and LED counts in platformio.ini's [signalbank] section; a
+// decoder built with others notices and falls back to its defaults.
+
+#include <eepromimage.h>
+#include <stdio.h>
+#include <fstream>
+#include <string>
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: eepromimage decoder.conf decoder.eep\n");
+    return 2;
+  }
+
+  std::ifstream input(argv[1]);
+  if (!input) {
+    fprintf(stderr, "Can't open %s\n", argv[1]);
+    return 1;
+  }
+  std::vector<eepromimage::CvWrite> writes;
+  std::string error;
+  if (!eepromimage::parseConfiguration(input, writes, error) || !eepromimage::apply(writes, error)) {
+    fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+    return 1;
+  }
+
+  std::ofstream output(argv[2]);
+  eepromimage::writeIntelHex(output, eepromimage::image());
+  if (!output) {
+    fprintf(stderr, "Can't write %s\n", argv[2]);
+    return 1;
+  }
+  return 0;
+}
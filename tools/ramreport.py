@@ -0,0 +1,60 @@
+# Prints how the firmware uses the RAM after each build, largest variables first, so changes
+# that eat into the stack show up right away. Also lists the constant tables kept in flash
+# with PROGMEM, i.e. the RAM they save. PlatformIO runs it for env:attiny85; it also works on
+# its own:
+#   python tools/ramreport.py .pio/build/attiny85/firmware.elf [avr-objdump] [RAM size]
+
+import re
+import subprocess
+import sys
+
+SHOWN_SYMBOLS = 12
+RAM_SECTIONS = (".data", ".bss", ".noinit")
+# The AVR linker script puts PROGMEM data into .text, together with the code
+FLASH_SECTIONS = (".text",)
+
+# "00800060 l     O .bss	00000014 signalBank"
+SYMBOL_LINE = re.compile(r"^[0-9a-fA-F]+ (.{7}) (\S+)\s+([0-9a-fA-F]+)\s+(.*)$")
+
+
+def objects(elf, objdump):
+    """All variables and constants as (section, size, name), largest first."""
+    output = subprocess.run([objdump, "-t", "-C", elf], check=True, capture_output=True, text=True).stdout
+    result = []
+    for line in output.splitlines():
+        match = SYMBOL_LINE.match(line)
+        if match and "O" in match.group(1):
+            result.append((match.group(2), int(match.group(3), 16), match.group(4).strip()))
+    return sorted(result, key=lambda symbol: -symbol[1])
+
+
+def print_symbols(symbols):
+    for _, size, name in symbols[:SHOWN_SYMBOLS]:
+        print("  %5d  %s" % (size, name))
+
+
+def report(elf, objdump, ram_size):
+    symbols = objects(elf, objdump)
+    ram = [symbol for symbol in symbols if symbol[0] in RAM_SECTIONS]
+    flash = [symbol for symbol in symbols if symbol[0] in FLASH_SECTIONS]
+
+    used = sum(size for _, size, _ in ram)
+    print("RAM: %d of %d bytes in variables, %d left for the stack" % (used, ram_size, ram_size - used))
+    print_symbols(ram)
+    print("Constants in flash instead of RAM: %d bytes" % sum(size for _, size, _ in flash))
+    print_symbols(flash)
+
+
+if __name__ == "__main__":
+    report(sys.argv[1],
+           sys.argv[2] if len(sys.argv) > 2 else "avr-objdump",
+           int(sys.argv[3]) if len(sys.argv) > 3 else 512)
+else:
+    Import("env")
+
+    def after_build(source, target, env):
+        objdump = env.subst("$CC").replace("gcc", "objdump")
+        ram_size = int(env.BoardConfig().get("upload.maximum_ram_size", 512))
+        report(str(source[0]), objdump, ram_size)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", after_build)